@@ -3,4 +3,4 @@
 set -eux
 
 LLVM_SOURCE_BASENAME=llvm_$LLVM_VERSION
-LLVM_BASENAME="${LLVM_SOURCE_BASENAME}_${BIRTH_ARCH}-${BIRTH_OS}-${CMAKE_BUILD_TYPE}${BASENAME_ASSERTION}"
+LLVM_BASENAME="${LLVM_SOURCE_BASENAME}_${BIRTH_ARCH}-${BIRTH_OS}-${CMAKE_BUILD_TYPE}${BASENAME_ASSERTION}${BASENAME_PGO:-}${BASENAME_BOLT:-}${BASENAME_THINLTO:-}"
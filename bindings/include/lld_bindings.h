@@ -6,6 +6,7 @@
 #endif
 
 typedef uint8_t u8;
+typedef uint32_t u32;
 typedef uint64_t u64;
 
 #ifndef BB_EXTERN_C
@@ -25,20 +26,222 @@ typedef struct str
 } str;
 #endif
 
+typedef struct LLDBytes
+{
+    u8* pointer;
+    u64 length;
+} LLDBytes;
+
 typedef struct LLDResult
 {
     str stdout_string;
     str stderr_string;
+    // The linked image, only filled when the link was asked to output to memory.
+    LLDBytes output;
     bool success;
+    // The result was replayed from the link cache without running lld.
+    bool cache_hit;
 } LLDResult;
 
 typedef u8* LldAllocationFn (void* context, u64 size, u64 alignment);
 
+typedef enum LLDOutputStream
+{
+    LLD_OUTPUT_STREAM_STDOUT,
+    LLD_OUTPUT_STREAM_STDERR,
+} LLDOutputStream;
+
+// Receives diagnostics as lld produces them. The bytes are only valid for the duration of the call.
+typedef void LldWriteFn (void* context, LLDOutputStream stream, const u8* pointer, u64 length);
+
+// An input file living in host memory. An argument equal to `name` is replaced by the buffer, so it keeps its
+// position on the command line; buffers no argument refers to are appended after the last argument.
+typedef struct LLDInputBuffer
+{
+    str name;
+    LLDBytes bytes;
+} LLDInputBuffer;
+
+typedef struct LLDPhaseTiming
+{
+    str name;
+    u64 nanoseconds;
+} LLDPhaseTiming;
+
+// Link statistics. Phases are the totals of lld's time-trace scopes by name, so they follow lld's own phase names and
+// are only available for in-process links that did not ask for --time-trace themselves and that run on a thread
+// without a time-trace profiler of the host's own.
+typedef struct LLDLinkStats
+{
+    LLDPhaseTiming* phase_pointer;
+    u64 phase_count;
+    u64 wall_nanoseconds;
+    // User plus system time of the whole process during the link; divided by the wall time and the thread count it
+    // gives the thread utilization.
+    u64 cpu_nanoseconds;
+    u64 thread_count;
+    // Memory held by lld's shared bump allocator (bAlloc, which backs its string savers) when the link finished.
+    // Objects created with make<T> live in per-type allocators that are not included.
+    u64 bump_allocator_bytes;
+    // Peak resident set size of the process so far (not only of this link).
+    u64 peak_resident_bytes;
+} LLDLinkStats;
+
+typedef struct LLDCallGraphEdge
+{
+    str caller;
+    str callee;
+    u64 weight;
+} LLDCallGraphEdge;
+
+// Profile-guided section layout, handed to lld as if it came from --symbol-ordering-file and
+// --call-graph-ordering-file (/order and /call-graph-ordering-file for COFF). Only ELF and COFF take it; lld rejects
+// an ordering list and a call graph in the same ELF link. lld warns about every listed symbol it cannot place, so the
+// unmatched part of a profile shows up in the link's stderr.
+typedef struct LLDLayoutProfile
+{
+    const str* symbol_pointer;
+    u64 symbol_count;
+    const LLDCallGraphEdge* edge_pointer;
+    u64 edge_count;
+} LLDLayoutProfile;
+
+typedef enum LLDDebugCompression
+{
+    LLD_DEBUG_COMPRESSION_DEFAULT,
+    LLD_DEBUG_COMPRESSION_NONE,
+    LLD_DEBUG_COMPRESSION_ZLIB,
+    LLD_DEBUG_COMPRESSION_ZSTD,
+} LLDDebugCompression;
+
+typedef struct LLDLinkOptions
+{
+    LLDInputBuffer* input_buffer_pointer;
+    u64 input_buffer_count;
+    // Write the linked image into memory obtained from the allocation function instead of the output path.
+    bool output_to_memory;
+    // When set, stdout and stderr are streamed to this function instead of being returned in LLDResult.
+    LldWriteFn* write_fn;
+    void* write_context;
+    // Content-addressed cache of successful links, disabled when empty. The key covers the LLVM version, the flavor,
+    // the absolute output path (some images embed it) and the arguments, where an argument naming an existing file
+    // (an @response file, or a file joined to its option as in --version-script=path, -Tpath or /def:path)
+    // contributes the file's contents rather than its path. ELF and Mach-O links also have lld list every file it
+    // read (--dependency-file, -dependency_info), and a hit is only taken while all of those still have the same
+    // contents. A hit is also refused once a file appears that the link searched for and did not find: Mach-O lists
+    // those itself, and for ELF the -L/-l search is replayed, but not the INPUT, GROUP and SEARCH_DIR lookups of
+    // linker scripts. COFF, MinGW and wasm links cannot list their inputs, so for those libraries found through
+    // search paths are keyed by their spelling only. Side outputs such as map files are not replayed. Least recently
+    // used entries are evicted once the directory grows past cache_size_limit bytes (0 means no limit).
+    str cache_directory;
+    u64 cache_size_limit;
+    // Filled with statistics about the link when set.
+    LLDLinkStats* stats;
+    // Runs the link in a child process that a worker process forks for it, whose address space acts as the link's
+    // arena: lld exits early inside the child, so all of its memory is released at once by the OS instead of by
+    // CommonLinkerContext::destroy, and neither the worker nor the host goes down with it. The host itself is never
+    // forked per link. Requires worker processes (lld_set_worker_process_count); the link fails without them. Output
+    // to memory still works, but phase statistics are not collected. Whether this beats the regular teardown depends
+    // on the link; lld_bindings_bench --mode=teardown measures both.
+    bool arena_teardown;
+    const LLDLayoutProfile* layout_profile;
+    // ELF only. Compresses the .debug_* output sections; the default leaves it to the arguments. A non-zero level
+    // overrides the algorithm's default level (zstd: 1-22, zlib: 1-9).
+    LLDDebugCompression debug_compression;
+    u32 debug_compression_level;
+    // Number of threads lld uses, including for compressing debug sections in parallel. 0 keeps lld's default of
+    // one per hardware thread.
+    u32 thread_count;
+} LLDLinkOptions;
+
 #define lld_api_args() char* const* argument_pointer, u64 argument_count, bool exit_early, bool disable_output, LldAllocationFn* allocate_fn, void* context
 #define lld_api_function_decl(link_name) LLDResult lld_ ## link_name ## _link(lld_api_args())
+#define lld_api_function_ex_decl(link_name) LLDResult lld_ ## link_name ## _link_ex(lld_api_args(), const LLDLinkOptions* options)
 
 BB_EXTERN_C lld_api_function_decl(coff);
 BB_EXTERN_C lld_api_function_decl(elf);
 BB_EXTERN_C lld_api_function_decl(mingw);
 BB_EXTERN_C lld_api_function_decl(macho);
 BB_EXTERN_C lld_api_function_decl(wasm);
+
+BB_EXTERN_C lld_api_function_ex_decl(coff);
+BB_EXTERN_C lld_api_function_ex_decl(elf);
+BB_EXTERN_C lld_api_function_ex_decl(mingw);
+BB_EXTERN_C lld_api_function_ex_decl(macho);
+BB_EXTERN_C lld_api_function_ex_decl(wasm);
+
+// By default links run inside the host process and are serialized, because lld keeps its state in process globals.
+// With a non-zero count every link is instead handed to one of `count` forked worker processes, so links issued from
+// different host threads run in parallel. Workers are forked when this is called, so it has to be called before the
+// first in-process link and is best called early, before the host has grown large; they are never forked again. A
+// worker that dies fails its link and is not replaced until this is called again. Relative paths are resolved against
+// the host's working directory at the time of each link. Passing 0 shuts the workers down. Returns false if the
+// workers could not be started or the platform has no fork (Windows).
+BB_EXTERN_C bool lld_set_worker_process_count(u32 count);
+
+typedef enum LLDFlavor
+{
+    LLD_FLAVOR_COFF,
+    LLD_FLAVOR_ELF,
+    LLD_FLAVOR_MINGW,
+    LLD_FLAVOR_MACHO,
+    LLD_FLAVOR_WASM,
+} LLDFlavor;
+
+// Asynchronous links run on an internal pool of threads and return a handle right away. The arguments are copied,
+// but anything the options point to (input buffers, stats, cache directory) has to outlive the link. Every handle
+// must be passed to lld_link_wait exactly once, which returns the result and releases the handle. The completion
+// function, when given, is called from a pool thread as soon as the result is ready; it may poll the handle, pass it
+// to another thread or start further asynchronous links, but must not wait on it itself or call
+// lld_set_async_thread_count, which joins the pool threads. The allocation function is also called from pool threads,
+// under a lock shared by all asynchronous links.
+typedef struct LLDLinkHandle LLDLinkHandle;
+typedef void LldCompletionFn (void* completion_context, LLDLinkHandle* handle);
+
+// Sets the number of pool threads, waiting for queued links to finish first. Defaults to one thread per worker
+// process, or one thread when linking in process, since in-process links are serialized anyway.
+BB_EXTERN_C void lld_set_async_thread_count(u32 count);
+BB_EXTERN_C LLDLinkHandle* lld_link_async(LLDFlavor flavor, char* const* argument_pointer, u64 argument_count, bool disable_output, LldAllocationFn* allocate_fn, void* context, const LLDLinkOptions* options, LldCompletionFn* completion_fn, void* completion_context);
+BB_EXTERN_C bool lld_link_poll(LLDLinkHandle* handle);
+BB_EXTERN_C LLDResult lld_link_wait(LLDLinkHandle* handle);
+
+// A session links many times with the same flavor. Output buffers are reused between links and the teardown of
+// the previous link's lld state is overlapped with the host's work instead of being paid inside the link call.
+typedef struct LLDSession LLDSession;
+
+#define lld_session_args() LLDSession* session, char* const* argument_pointer, u64 argument_count, bool disable_output, LldAllocationFn* allocate_fn, void* context, const LLDLinkOptions* options
+
+BB_EXTERN_C LLDSession* lld_session_create(LLDFlavor flavor);
+BB_EXTERN_C LLDResult lld_session_link(lld_session_args());
+BB_EXTERN_C void lld_session_destroy(LLDSession* session);
+
+// Links relocatable objects straight into executable memory of the host process with LLVM's JITLink, for running
+// code without producing an image. The arguments are laid out like a linker command line but only name inputs:
+// object files, static archives (members are pulled in on demand) and shared libraries. Input buffers from the
+// options are linked as well, except for shared libraries, which the dynamic loader can only load from a file; the
+// other options are ignored. Undefined symbols are also resolved against the host process. Static constructors of
+// the inputs are not run.
+typedef struct LLDJit LLDJit;
+
+typedef struct LLDJitSymbol
+{
+    str name;
+    u64 address;
+} LLDJitSymbol;
+
+typedef struct LLDJitResult
+{
+    // Owns the linked code; it stays mapped until lld_jit_destroy.
+    LLDJit* jit;
+    // Every global symbol defined by the object inputs, with its name as spelled in the object file.
+    LLDJitSymbol* symbol_pointer;
+    u64 symbol_count;
+    str stderr_string;
+    bool success;
+} LLDJitResult;
+
+BB_EXTERN_C LLDJitResult lld_jit_link(char* const* argument_pointer, u64 argument_count, const LLDLinkOptions* options, LldAllocationFn* allocate_fn, void* context);
+// Returns the address of a symbol spelled as in the object file (including any global prefix), linking archive
+// members in on demand, or 0 if it cannot be resolved.
+BB_EXTERN_C u64 lld_jit_lookup(LLDJit* jit, str name);
+BB_EXTERN_C void lld_jit_destroy(LLDJit* jit);
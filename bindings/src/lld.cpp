@@ -1,6 +1,44 @@
 #include <lld_bindings.h>
 
 #include "lld/Common/CommonLinkerContext.h"
+#include "lld/Common/ErrorHandler.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/BLAKE3.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #ifndef BB_EXPORT
 #define BB_EXPORT extern "C"
@@ -26,56 +64,2291 @@ namespace lld
     lld_link_decl(wasm);
 }
 
-fn LLDResult lld_api_generic(lld_api_args(), LinkerFunction linker_function)
+fn str lld_copy_string(const std::string& string, LldAllocationFn* allocate_fn, void* context)
 {
-    LLDResult result = {};
-    auto arguments = llvm::ArrayRef(argument_pointer, argument_count);
+    str result = {};
 
-    std::string stdout_string;
-    llvm::raw_string_ostream stdout_stream(stdout_string);
+    static_assert(sizeof(char) == sizeof(u8));
+    static_assert(alignof(char) == alignof(u8));
 
-    std::string stderr_string;
-    llvm::raw_string_ostream stderr_stream(stderr_string);
+    auto length = string.length();
+    if (length)
+    {
+        auto* pointer = allocate_fn(context, length + 1, 1);
+        memcpy(pointer, string.data(), length);
+        result.pointer = (char*)pointer;
+        result.length = length;
+        pointer[length] = 0;
+    }
 
-    result.success = linker_function(arguments, stdout_stream, stderr_stream, exit_early, disable_output);
+    return result;
+}
 
-    static_assert(sizeof(char) == sizeof(u8));
-    static_assert(alignof(char) == alignof(u8));
+// Forwards whatever lld writes to the host as soon as the stream is flushed, without accumulating it.
+class LLDCallbackStream : public llvm::raw_ostream
+{
+    LldWriteFn* write_fn;
+    void* write_context;
+    LLDOutputStream stream;
+    std::string* copy;
+    u64 position = 0;
+
+    void write_impl(const char* pointer, size_t size) override
+    {
+        write_fn(write_context, stream, (const u8*)pointer, size);
+        if (copy)
+        {
+            copy->append(pointer, size);
+        }
+
+        position += size;
+    }
+
+    uint64_t current_pos() const override
+    {
+        return position;
+    }
+
+public:
+    LLDCallbackStream(LldWriteFn* write_fn, void* write_context, LLDOutputStream stream, std::string* copy) : write_fn(write_fn), write_context(write_context), stream(stream), copy(copy)
+    {
+    }
+
+    ~LLDCallbackStream() override
+    {
+        flush();
+    }
+};
+
+// Everything a link owns besides lld's own context: the final argument vector and the files staged for in-memory
+// inputs. It has to outlive the context, since lld keeps its inputs mapped until the context is destroyed.
+struct LLDLinkJob
+{
+    llvm::BumpPtrAllocator allocator;
+    llvm::StringSaver saver{allocator};
+    std::vector<const char*> arguments;
+    llvm::SmallString<128> staging_directory;
+    // Name and staged path of every in-memory input.
+    std::vector<std::pair<llvm::StringRef, const char*>> staged_inputs;
+    const char* output_path = nullptr;
+};
+
+// lld only opens and writes files by path, so in-memory inputs and outputs are staged as files. On Linux they go to
+// /dev/shm, which is memory backed, so the bytes never reach a disk.
+fn std::error_code lld_staging_directory(LLDLinkJob& job)
+{
+    if (job.staging_directory.empty())
+    {
+        llvm::StringRef prefix = "lld-staging";
+#if defined(__linux__)
+        if (llvm::sys::fs::is_directory("/dev/shm"))
+        {
+            prefix = "/dev/shm/lld-staging";
+        }
+#endif
+        return llvm::sys::fs::createUniqueDirectory(prefix, job.staging_directory);
+    }
+
+    return {};
+}
+
+fn std::error_code lld_stage_file(LLDLinkJob& job, llvm::StringRef file_name, llvm::StringRef bytes, const char*& staged_path_pointer)
+{
+    if (auto error_code = lld_staging_directory(job))
+    {
+        return error_code;
+    }
+
+    llvm::SmallString<128> staged_path(job.staging_directory);
+    llvm::sys::path::append(staged_path, file_name);
+
+    std::error_code error_code;
+    llvm::raw_fd_ostream stream(staged_path, error_code, llvm::sys::fs::OF_None);
+    if (error_code)
+    {
+        return error_code;
+    }
+
+    stream << bytes;
+    stream.close();
+    if (stream.has_error())
+    {
+        error_code = stream.error();
+        stream.clear_error();
+        return error_code;
+    }
+
+    staged_path_pointer = job.saver.save(staged_path.str()).data();
+    return {};
+}
+
+fn std::error_code lld_stage_buffer(LLDLinkJob& job, const LLDInputBuffer& buffer)
+{
+    auto name = llvm::StringRef(buffer.name.pointer, buffer.name.length);
+    auto file_name = (llvm::Twine(job.staged_inputs.size()) + "_" + llvm::sys::path::filename(name)).str();
+    const char* staged_path;
+    if (auto error_code = lld_stage_file(job, file_name, llvm::StringRef((const char*)buffer.bytes.pointer, buffer.bytes.length), staged_path))
+    {
+        return error_code;
+    }
+
+    job.staged_inputs.push_back({ job.saver.save(name), staged_path });
+    return {};
+}
+
+// Stages the profile in the text formats of the ordering file options and appends those options to the arguments.
+fn bool lld_stage_layout_profile(LLDLinkJob& job, LLDFlavor flavor, const LLDLayoutProfile& profile, llvm::raw_ostream& stderr_stream)
+{
+    if (flavor != LLD_FLAVOR_ELF && flavor != LLD_FLAVOR_COFF)
+    {
+        stderr_stream << "error: layout profiles are only supported for ELF and COFF links\n";
+        return false;
+    }
+
+    if (profile.symbol_count)
+    {
+        std::string text;
+        for (auto& symbol : llvm::ArrayRef(profile.symbol_pointer, profile.symbol_count))
+        {
+            text.append(symbol.pointer, symbol.length);
+            text += '\n';
+        }
 
-    auto stdout_length = stdout_string.length();
-    if (stdout_length)
+        const char* path;
+        if (auto error_code = lld_stage_file(job, "symbol_order.txt", text, path))
+        {
+            stderr_stream << "error: cannot stage symbol ordering list: " << error_code.message() << "\n";
+            return false;
+        }
+
+        if (flavor == LLD_FLAVOR_COFF)
+        {
+            job.arguments.push_back(job.saver.save(llvm::Twine("/order:@") + path).data());
+        }
+        else
+        {
+            job.arguments.push_back("--symbol-ordering-file");
+            job.arguments.push_back(path);
+        }
+    }
+
+    if (profile.edge_count)
+    {
+        std::string text;
+        llvm::raw_string_ostream stream(text);
+        for (auto& edge : llvm::ArrayRef(profile.edge_pointer, profile.edge_count))
+        {
+            stream << llvm::StringRef(edge.caller.pointer, edge.caller.length) << ' ' << llvm::StringRef(edge.callee.pointer, edge.callee.length) << ' ' << edge.weight << '\n';
+        }
+
+        const char* path;
+        if (auto error_code = lld_stage_file(job, "call_graph.txt", text, path))
+        {
+            stderr_stream << "error: cannot stage call graph: " << error_code.message() << "\n";
+            return false;
+        }
+
+        if (flavor == LLD_FLAVOR_COFF)
+        {
+            job.arguments.push_back(job.saver.save(llvm::Twine("/call-graph-ordering-file:") + path).data());
+        }
+        else
+        {
+            job.arguments.push_back("--call-graph-ordering-file");
+            job.arguments.push_back(path);
+        }
+    }
+
+    return true;
+}
+
+fn bool lld_stage_output(LLDLinkJob& job, LLDFlavor flavor, llvm::raw_ostream& stderr_stream)
+{
+    if (auto error_code = lld_staging_directory(job))
+    {
+        stderr_stream << "error: cannot stage output: " << error_code.message() << "\n";
+        return false;
+    }
+
+    llvm::SmallString<128> output_path(job.staging_directory);
+    llvm::sys::path::append(output_path, "output");
+    job.output_path = job.saver.save(output_path.str()).data();
+
+    // The last output flag wins in every driver, so appending it overrides whatever the caller passed.
+    if (flavor == LLD_FLAVOR_COFF)
+    {
+        job.arguments.push_back(job.saver.save(llvm::Twine("/out:") + job.output_path).data());
+    }
+    else
     {
-        auto* stdout_pointer = allocate_fn(context, stdout_length + 1, 1);
-        memcpy(stdout_pointer, stdout_string.data(), stdout_length);
-        result.stdout_string.pointer = (char*)stdout_pointer;
-        result.stdout_string.length = stdout_length;
-        stdout_pointer[stdout_length] = 0;
+        job.arguments.push_back("-o");
+        job.arguments.push_back(job.output_path);
     }
 
-    auto stderr_length = stderr_string.length();
-    if (stderr_length)
+    return true;
+}
+
+fn LLDBytes lld_read_output(LLDLinkJob& job, LldAllocationFn* allocate_fn, void* context, llvm::raw_ostream& stderr_stream)
+{
+    LLDBytes result = {};
+
+    auto buffer_or_error = llvm::MemoryBuffer::getFile(job.output_path, /* IsText */ false, /* RequiresNullTerminator */ false);
+    if (!buffer_or_error)
     {
-        auto* stderr_pointer = allocate_fn(context, stderr_length + 1, 1);
-        memcpy(stderr_pointer, stderr_string.data(), stderr_length);
-        result.stderr_string.pointer = (char*)stderr_pointer;
-        result.stderr_string.length = stderr_length;
-        stderr_pointer[stderr_length] = 0;
+        stderr_stream << "error: cannot read linked output: " << buffer_or_error.getError().message() << "\n";
+        return result;
     }
 
-    // TODO: should we only call it on success?
-    lld::CommonLinkerContext::destroy();
+    auto& buffer = *buffer_or_error;
+    auto length = buffer->getBufferSize();
+    if (length)
+    {
+        result.pointer = allocate_fn(context, length, 16);
+        memcpy(result.pointer, buffer->getBufferStart(), length);
+        result.length = length;
+    }
 
     return result;
 }
 
-#define lld_api_function_impl(link_name) \
-BB_EXPORT lld_api_function_decl(link_name)\
-{\
-    return lld_api_generic(argument_pointer, argument_count, exit_early, disable_output, allocate_fn, context, lld::link_name::link);\
+fn bool lld_link_job_add_options(LLDLinkJob& job, LLDFlavor flavor, const LLDLinkOptions& options, llvm::raw_ostream& stderr_stream)
+{
+    if (options.debug_compression != LLD_DEBUG_COMPRESSION_DEFAULT)
+    {
+        if (flavor != LLD_FLAVOR_ELF)
+        {
+            stderr_stream << "error: debug section compression is only supported for ELF links\n";
+            return false;
+        }
+
+        const char* algorithm = nullptr;
+        switch (options.debug_compression)
+        {
+            case LLD_DEBUG_COMPRESSION_NONE: algorithm = "none"; break;
+            case LLD_DEBUG_COMPRESSION_ZLIB: algorithm = "zlib"; break;
+            case LLD_DEBUG_COMPRESSION_ZSTD: algorithm = "zstd"; break;
+            default:
+            {
+                stderr_stream << "error: unknown debug section compression " << (u32)options.debug_compression << "\n";
+                return false;
+            }
+        }
+
+        if (options.debug_compression == LLD_DEBUG_COMPRESSION_ZSTD && !llvm::compression::zstd::isAvailable())
+        {
+            stderr_stream << "error: zstd debug section compression requested, but LLVM was built without zstd\n";
+            return false;
+        }
+
+        if (options.debug_compression == LLD_DEBUG_COMPRESSION_ZLIB && !llvm::compression::zlib::isAvailable())
+        {
+            stderr_stream << "error: zlib debug section compression requested, but LLVM was built without zlib\n";
+            return false;
+        }
+
+        // --compress-sections takes a level, unlike --compress-debug-sections, and overrides it when both are given.
+        std::string argument = std::string("--compress-sections=.debug_*=") + algorithm;
+        if (options.debug_compression_level && options.debug_compression != LLD_DEBUG_COMPRESSION_NONE)
+        {
+            argument += ":" + std::to_string(options.debug_compression_level);
+        }
+
+        job.arguments.push_back(job.saver.save(argument).data());
+    }
+
+    if (options.thread_count)
+    {
+        auto* prefix = flavor == LLD_FLAVOR_COFF ? "/threads:" : "--threads=";
+        job.arguments.push_back(job.saver.save(llvm::Twine(prefix) + llvm::Twine(options.thread_count)).data());
+    }
+
+    return true;
+}
+
+fn bool lld_link_job_prepare(LLDLinkJob& job, LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, const LLDLinkOptions* options, llvm::raw_ostream& stderr_stream)
+{
+    job.arguments.assign(arguments.begin(), arguments.end());
+
+    if (options)
+    {
+        for (u64 i = 0; i < options->input_buffer_count; i += 1)
+        {
+            auto& buffer = options->input_buffer_pointer[i];
+            if (auto error_code = lld_stage_buffer(job, buffer))
+            {
+                stderr_stream << "error: cannot stage input buffer " << llvm::StringRef(buffer.name.pointer, buffer.name.length) << ": " << error_code.message() << "\n";
+                return false;
+            }
+        }
+    }
+
+    for (auto [name, path] : job.staged_inputs)
+    {
+        bool referenced = false;
+        for (u64 argument_index = 1; argument_index < arguments.size(); argument_index += 1)
+        {
+            if (llvm::StringRef(arguments[argument_index]) == name)
+            {
+                job.arguments[argument_index] = path;
+                referenced = true;
+            }
+        }
+
+        if (!referenced)
+        {
+            job.arguments.push_back(path);
+        }
+    }
+
+    if (options && !lld_link_job_add_options(job, flavor, *options, stderr_stream))
+    {
+        return false;
+    }
+
+    if (options && options->layout_profile && !lld_stage_layout_profile(job, flavor, *options->layout_profile, stderr_stream))
+    {
+        return false;
+    }
+
+    if (options && options->output_to_memory && !lld_stage_output(job, flavor, stderr_stream))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+fn void lld_link_job_finish(LLDLinkJob& job)
+{
+    if (!job.staging_directory.empty())
+    {
+        llvm::sys::fs::remove_directories(job.staging_directory);
+        job.staging_directory.clear();
+    }
+}
+
+struct LLDCacheEntryHeader
+{
+    u64 magic;
+    u64 manifest_length;
+    u64 stdout_length;
+    u64 stderr_length;
+    u64 output_length;
+};
+
+#define LLD_CACHE_ENTRY_MAGIC 0x32454843444c4c // "LLDCHE2"
+
+struct LLDCacheLink
+{
+    LLDFlavor flavor;
+    llvm::SmallString<128> entry_path;
+    // Empty when the output goes to memory.
+    llvm::StringRef output_path;
+    // File lld lists every input it read in. It is removed after the link unless the caller asked for it.
+    llvm::SmallString<128> dependency_path;
+    bool dependency_path_requested = false;
+    // Files already covered by the key by content, which the manifest of the entry leaves out.
+    llvm::StringSet<> keyed_paths;
+    // ELF -L directories and -l names in order. The dependency file only lists what was found, so the manifest replays
+    // the search to record the candidates that did not exist.
+    std::vector<llvm::StringRef> search_directories;
+    std::vector<llvm::StringRef> library_names;
+    llvm::SmallString<128> staging_directory;
+};
+
+fn bool lld_is_output_flag(LLDFlavor flavor, llvm::StringRef argument)
+{
+    return flavor != LLD_FLAVOR_COFF && (argument == "-o" || argument == "--output" || argument == "-output");
+}
+
+fn bool lld_is_joined_output_flag(LLDFlavor flavor, llvm::StringRef argument, llvm::StringRef& output)
+{
+    if (flavor == LLD_FLAVOR_COFF)
+    {
+        if (argument.starts_with_insensitive("/out:") || argument.starts_with_insensitive("-out:"))
+        {
+            output = argument.drop_front(5);
+            return true;
+        }
+    }
+    else if (argument.consume_front("--output="))
+    {
+        output = argument;
+        return true;
+    }
+
+    return false;
+}
+
+// Only ELF (--dependency-file) and Mach-O (-dependency_info) can list the files a link read.
+fn bool lld_is_dependency_file_flag(LLDFlavor flavor, llvm::StringRef argument)
+{
+    switch (flavor)
+    {
+        case LLD_FLAVOR_ELF: return argument == "--dependency-file" || argument == "-dependency-file";
+        case LLD_FLAVOR_MACHO: return argument == "-dependency_info";
+        default: return false;
+    }
+}
+
+fn bool lld_is_joined_dependency_file_flag(LLDFlavor flavor, llvm::StringRef argument, llvm::StringRef& path)
+{
+    if (flavor == LLD_FLAVOR_ELF && (argument.consume_front("--dependency-file=") || argument.consume_front("-dependency-file=")))
+    {
+        path = argument;
+        return true;
+    }
+
+    return false;
+}
+
+// Returns the input file joined to an option's spelling (--version-script=path, -Tpath, /def:path), or an empty
+// string for any other argument.
+fn llvm::StringRef lld_joined_input_path(LLDFlavor flavor, llvm::StringRef argument)
+{
+    if (flavor == LLD_FLAVOR_COFF)
+    {
+        static const char* const prefixes[] = { "def:", "wholearchive:", "defaultlib:", "natvis:", "manifestinput:", "order:@", "call-graph-ordering-file:" };
+        if (argument.consume_front("/") || argument.consume_front("-"))
+        {
+            for (auto* prefix : prefixes)
+            {
+                if (argument.starts_with_insensitive(prefix))
+                {
+                    return argument.drop_front(strlen(prefix));
+                }
+            }
+        }
+    }
+    else
+    {
+        static const char* const prefixes[] = { "version-script=", "dynamic-list=", "script=", "T", "symbol-ordering-file=", "call-graph-ordering-file=", "just-symbols=", "retain-symbols-file=", "export-dynamic-symbol-list=", "allow-undefined-file=" };
+        if (argument.consume_front("--") || argument.consume_front("-"))
+        {
+            for (auto* prefix : prefixes)
+            {
+                if (argument.starts_with(prefix))
+                {
+                    return argument.drop_front(strlen(prefix));
+                }
+            }
+        }
+    }
+
+    return {};
+}
+
+fn std::string lld_cache_hash_file(llvm::StringRef path)
+{
+    auto buffer_or_error = llvm::MemoryBuffer::getFile(path, /* IsText */ false, /* RequiresNullTerminator */ false);
+    if (!buffer_or_error)
+    {
+        return {};
+    }
+
+    llvm::BLAKE3 hasher;
+    hasher.update((*buffer_or_error)->getBuffer());
+    return llvm::toHex(hasher.final<16>(), /* LowerCase */ true);
+}
+
+// Fills the cache link when the link is cacheable, and has lld list the files it reads where it can.
+fn bool lld_cache_entry(LLDLinkJob& job, LLDFlavor flavor, const LLDLinkOptions* options, bool disable_output, LLDCacheLink& cache)
+{
+    if (!options || !options->cache_directory.length || disable_output)
+    {
+        return false;
+    }
+
+    cache.flavor = flavor;
+    cache.staging_directory = job.staging_directory;
+
+    // Another LLVM release may link the same inputs differently.
+    llvm::BLAKE3 hasher;
+    hasher.update(LLVM_VERSION_STRING);
+    hasher.update(llvm::StringRef("", 1));
+    u64 key_flavor = flavor;
+    hasher.update(llvm::ArrayRef((const u8*)&key_flavor, sizeof(key_flavor)));
+
+    for (u64 i = 1; i < job.arguments.size(); i += 1)
+    {
+        llvm::StringRef argument = job.arguments[i];
+        llvm::StringRef output;
+
+        if (lld_is_output_flag(flavor, argument) && i + 1 < job.arguments.size())
+        {
+            i += 1;
+            cache.output_path = job.arguments[i];
+            continue;
+        }
+
+        if (lld_is_joined_output_flag(flavor, argument, output))
+        {
+            cache.output_path = output;
+            continue;
+        }
+
+        if (flavor == LLD_FLAVOR_ELF)
+        {
+            auto next = i + 1 < job.arguments.size() ? llvm::StringRef(job.arguments[i + 1]) : llvm::StringRef();
+            llvm::StringRef value = argument;
+            if (argument == "-L" || argument == "--library-path")
+            {
+                cache.search_directories.push_back(next);
+            }
+            else if (value.consume_front("--library-path=") || (value.consume_front("-L") && !value.empty()))
+            {
+                cache.search_directories.push_back(value);
+            }
+            else if (argument == "-l" || argument == "--library")
+            {
+                cache.library_names.push_back(next);
+            }
+            else if (value.consume_front("--library=") || (value.consume_front("-l") && !value.empty()))
+            {
+                cache.library_names.push_back(value);
+            }
+        }
+
+        auto file_path = argument;
+        file_path.consume_front("@");
+
+        // Staged files can also be joined to an option (/order:@path); those are keyed by content as well.
+        auto staged_position = job.staging_directory.empty() ? llvm::StringRef::npos : argument.find(job.staging_directory);
+        auto joined_path = lld_joined_input_path(flavor, argument);
+        if (staged_position != llvm::StringRef::npos)
+        {
+            file_path = argument.drop_front(staged_position);
+        }
+        else if (!joined_path.empty())
+        {
+            file_path = joined_path;
+        }
+
+        // The dependency file is written by the link itself, so it is keyed by its spelling only.
+        llvm::StringRef dependency_path;
+        if (lld_is_dependency_file_flag(flavor, argument) && i + 1 < job.arguments.size())
+        {
+            cache.dependency_path = job.arguments[i + 1];
+            cache.dependency_path_requested = true;
+        }
+        else if (lld_is_joined_dependency_file_flag(flavor, argument, dependency_path))
+        {
+            cache.dependency_path = dependency_path;
+            cache.dependency_path_requested = true;
+            file_path = {};
+        }
+        else if (i > 1 && lld_is_dependency_file_flag(flavor, job.arguments[i - 1]))
+        {
+            file_path = {};
+        }
+
+        if (!file_path.empty() && llvm::sys::fs::is_regular_file(file_path))
+        {
+            auto buffer_or_error = llvm::MemoryBuffer::getFile(file_path, /* IsText */ false, /* RequiresNullTerminator */ false);
+            if (!buffer_or_error)
+            {
+                return false;
+            }
+
+            hasher.update("F");
+            hasher.update(argument.take_front(argument.size() - file_path.size()));
+            hasher.update((*buffer_or_error)->getBuffer());
+            cache.keyed_paths.insert(file_path);
+        }
+        else
+        {
+            hasher.update("A");
+            hasher.update(argument);
+        }
+
+        // Separate the arguments so that their concatenation is not ambiguous.
+        hasher.update(llvm::StringRef("", 1));
+    }
+
+    if (job.output_path)
+    {
+        cache.output_path = {};
+    }
+    else if (cache.output_path.empty())
+    {
+        // Without an explicit output the driver derives one, and a hit would have nowhere to go.
+        return false;
+    }
+    else
+    {
+        // Some images embed the output path: the LC_ID_DYLIB of a Mach-O dylib without -install_name, or the PDB path
+        // COFF /debug derives from /out, which lld makes absolute. A staged in-memory output has a fresh path every
+        // link, so it is left out and a hit carries the staging path of the link that stored it.
+        llvm::SmallString<128> absolute_output_path(cache.output_path);
+        llvm::sys::fs::make_absolute(absolute_output_path);
+        hasher.update("O");
+        hasher.update(absolute_output_path);
+        hasher.update(llvm::StringRef("", 1));
+    }
+
+    auto cache_directory = llvm::StringRef(options->cache_directory.pointer, options->cache_directory.length);
+    auto key = hasher.final<16>();
+    cache.entry_path = cache_directory;
+    llvm::sys::path::append(cache.entry_path, "llvmcache-lld-" + llvm::toHex(key, /* LowerCase */ true));
+
+    if ((flavor == LLD_FLAVOR_ELF || flavor == LLD_FLAVOR_MACHO) && cache.dependency_path.empty())
+    {
+        // lld fails the link when it cannot write the file, so its directory has to exist. The name keeps it out of
+        // the pruning, which only looks at llvmcache- files.
+        llvm::SmallString<128> model(cache_directory);
+        llvm::sys::path::append(model, "lld-dependencies-%%%%%%%%");
+        if (llvm::sys::fs::create_directories(cache_directory))
+        {
+            return false;
+        }
+
+        llvm::sys::fs::createUniquePath(model, cache.dependency_path, /* MakeAbsolute */ false);
+
+        if (flavor == LLD_FLAVOR_ELF)
+        {
+            job.arguments.push_back(job.saver.save(llvm::Twine("--dependency-file=") + cache.dependency_path).data());
+        }
+        else
+        {
+            job.arguments.push_back("-dependency_info");
+            job.arguments.push_back(job.saver.save(cache.dependency_path.str()).data());
+        }
+    }
+
+    return true;
+}
+
+// The first rule of the dependency file lld writes names the output followed by every input, one per continued line,
+// with spaces and '#' escaped by a backslash and '$' doubled.
+fn bool lld_parse_dependency_file(llvm::StringRef text, std::vector<std::string>& paths)
+{
+    text = text.split("\n\n").first;
+
+    std::vector<std::string> words;
+    std::string word;
+    for (u64 i = 0; i < text.size(); i += 1)
+    {
+        char c = text[i];
+        bool separator = c == ' ' || c == '\t' || c == '\n';
+
+        if (c == '\\' && i + 1 < text.size() && (text[i + 1] == ' ' || text[i + 1] == '#' || text[i + 1] == '\n'))
+        {
+            i += 1;
+            separator = text[i] == '\n';
+            c = text[i];
+        }
+        else if (c == '$' && i + 1 < text.size() && text[i + 1] == '$')
+        {
+            i += 1;
+        }
+
+        if (separator)
+        {
+            if (!word.empty())
+            {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+        }
+        else
+        {
+            word += c;
+        }
+    }
+
+    if (!word.empty())
+    {
+        words.push_back(std::move(word));
+    }
+
+    // The target is the first word, ending with the colon.
+    if (words.empty() || !llvm::StringRef(words[0]).ends_with(":"))
+    {
+        return false;
+    }
+
+    paths.insert(paths.end(), std::make_move_iterator(words.begin() + 1), std::make_move_iterator(words.end()));
+    return true;
+}
+
+// Mach-O dependency info is a list of records, each an opcode byte followed by a NUL-terminated path: 0x10 for a file
+// the link read and 0x11 for one it searched for but did not find.
+fn bool lld_parse_dependency_info(llvm::StringRef data, std::vector<std::string>& paths, std::vector<std::string>& missing_paths)
+{
+    while (!data.empty())
+    {
+        auto end = data.find('\0', 1);
+        if (end == llvm::StringRef::npos)
+        {
+            return false;
+        }
+
+        auto path = data.slice(1, end);
+        switch ((u8)data.front())
+        {
+            case 0x10: paths.push_back(path.str()); break;
+            case 0x11: missing_paths.push_back(path.str()); break;
+        }
+
+        data = data.drop_front(end + 1);
+    }
+
+    return true;
+}
+
+// The manifest of an entry lists the inputs that are not already part of its key, so that a hit can be checked
+// against libraries found through search paths and files pulled in by linker scripts:
+//     input <hash> <path>
+//     missing <path>                           (searched for but not found, so it must not appear)
+fn bool lld_cache_manifest(const LLDCacheLink& cache, std::string& manifest)
+{
+    if (cache.dependency_path.empty())
+    {
+        return true;
+    }
+
+    std::vector<std::string> paths;
+    std::vector<std::string> missing_paths;
+    {
+        auto buffer_or_error = llvm::MemoryBuffer::getFile(cache.dependency_path, /* IsText */ false, /* RequiresNullTerminator */ false);
+        if (!buffer_or_error)
+        {
+            return false;
+        }
+
+        auto text = (*buffer_or_error)->getBuffer();
+        if (cache.flavor == LLD_FLAVOR_MACHO ? !lld_parse_dependency_info(text, paths, missing_paths) : !lld_parse_dependency_file(text, paths))
+        {
+            return false;
+        }
+    }
+
+    llvm::raw_string_ostream stream(manifest);
+    for (auto& path : paths)
+    {
+        if (cache.keyed_paths.contains(path) || (!cache.staging_directory.empty() && llvm::StringRef(path).starts_with(cache.staging_directory)))
+        {
+            continue;
+        }
+
+        // Without the content of every input the entry cannot be vouched for.
+        auto hash = lld_cache_hash_file(path);
+        if (hash.empty())
+        {
+            return false;
+        }
+
+        stream << "input " << hash << " " << path << "\n";
+    }
+
+    for (auto& path : missing_paths)
+    {
+        stream << "missing " << path << "\n";
+    }
+
+    // Replays lld's ELF search for -l: every directory in order, the shared library before the archive, stopping at the
+    // first candidate that exists. Anything earlier would shadow the library that was found, should it appear.
+    for (auto name : cache.library_names)
+    {
+        for (auto directory : cache.search_directories)
+        {
+            llvm::SmallString<128> candidates[2];
+            u64 candidate_count = 0;
+            if (name.starts_with(":"))
+            {
+                llvm::sys::path::append(candidates[candidate_count++], directory, name.drop_front(1));
+            }
+            else
+            {
+                llvm::sys::path::append(candidates[candidate_count++], directory, "lib" + name + ".so");
+                llvm::sys::path::append(candidates[candidate_count++], directory, "lib" + name + ".a");
+            }
+
+            bool found = false;
+            for (u64 i = 0; i < candidate_count && !found; i += 1)
+            {
+                found = llvm::sys::fs::exists(candidates[i]);
+                if (!found)
+                {
+                    stream << "missing " << candidates[i] << "\n";
+                }
+            }
+
+            if (found)
+            {
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+fn bool lld_cache_manifest_matches(llvm::StringRef manifest)
+{
+    while (!manifest.empty())
+    {
+        llvm::StringRef line;
+        std::tie(line, manifest) = manifest.split('\n');
+        auto [kind, rest] = line.split(' ');
+
+        if (kind == "input")
+        {
+            auto [hash, path] = rest.split(' ');
+            if (lld_cache_hash_file(path) != hash)
+            {
+                return false;
+            }
+        }
+        else if (kind == "missing")
+        {
+            if (llvm::sys::fs::exists(rest))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-lld_api_function_impl(coff)
-lld_api_function_impl(elf)
-lld_api_function_impl(mingw)
-lld_api_function_impl(macho)
-lld_api_function_impl(wasm)
+fn bool lld_cache_lookup(const LLDCacheLink& cache, LLDResult& result, llvm::raw_ostream& stdout_stream, llvm::raw_ostream& stderr_stream, LldAllocationFn* allocate_fn, void* context)
+{
+    auto buffer_or_error = llvm::MemoryBuffer::getFile(cache.entry_path, /* IsText */ false, /* RequiresNullTerminator */ false);
+    if (!buffer_or_error)
+    {
+        return false;
+    }
+
+    auto contents = (*buffer_or_error)->getBuffer();
+    LLDCacheEntryHeader header;
+    if (contents.size() < sizeof(header))
+    {
+        return false;
+    }
+
+    memcpy(&header, contents.data(), sizeof(header));
+    contents = contents.drop_front(sizeof(header));
+    if (header.magic != LLD_CACHE_ENTRY_MAGIC || contents.size() != header.manifest_length + header.stdout_length + header.stderr_length + header.output_length)
+    {
+        return false;
+    }
+
+    auto manifest = contents.take_front(header.manifest_length);
+    contents = contents.drop_front(header.manifest_length);
+    auto stdout_text = contents.take_front(header.stdout_length);
+    auto stderr_text = contents.drop_front(header.stdout_length).take_front(header.stderr_length);
+    auto output = contents.take_back(header.output_length);
+
+    if (!lld_cache_manifest_matches(manifest))
+    {
+        return false;
+    }
+
+    if (cache.output_path.empty())
+    {
+        if (output.size())
+        {
+            result.output.pointer = allocate_fn(context, output.size(), 16);
+            memcpy(result.output.pointer, output.data(), output.size());
+            result.output.length = output.size();
+        }
+    }
+    else
+    {
+        auto temporary_or_error = llvm::sys::fs::TempFile::create(cache.output_path + ".tmp%%%%%%%", llvm::sys::fs::all_read | llvm::sys::fs::all_write | llvm::sys::fs::all_exe);
+        if (!temporary_or_error)
+        {
+            llvm::consumeError(temporary_or_error.takeError());
+            return false;
+        }
+
+        {
+            llvm::raw_fd_ostream stream(temporary_or_error->FD, /* shouldClose */ false);
+            stream << output;
+            stream.flush();
+            if (stream.has_error())
+            {
+                stream.clear_error();
+                llvm::consumeError(temporary_or_error->discard());
+                return false;
+            }
+        }
+
+        if (auto error = temporary_or_error->keep(cache.output_path))
+        {
+            llvm::consumeError(std::move(error));
+            return false;
+        }
+    }
+
+    stdout_stream << stdout_text;
+    stderr_stream << stderr_text;
+
+    // Eviction goes by access time, which many file systems only update lazily.
+    int fd;
+    if (!llvm::sys::fs::openFileForRead(cache.entry_path, fd))
+    {
+        llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+
+    result.success = true;
+    result.cache_hit = true;
+    return true;
+}
+
+fn void lld_cache_store(const LLDCacheLink& cache, const LLDLinkOptions* options, const LLDResult& result, llvm::StringRef stdout_text, llvm::StringRef stderr_text)
+{
+    std::string manifest;
+    if (!lld_cache_manifest(cache, manifest))
+    {
+        return;
+    }
+
+    auto cache_directory = llvm::sys::path::parent_path(cache.entry_path);
+    if (llvm::sys::fs::create_directories(cache_directory))
+    {
+        return;
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> output_buffer;
+    auto output = llvm::StringRef((const char*)result.output.pointer, result.output.length);
+    if (!cache.output_path.empty())
+    {
+        auto buffer_or_error = llvm::MemoryBuffer::getFile(cache.output_path, /* IsText */ false, /* RequiresNullTerminator */ false);
+        if (!buffer_or_error)
+        {
+            return;
+        }
+
+        output_buffer = std::move(*buffer_or_error);
+        output = output_buffer->getBuffer();
+    }
+
+    auto temporary_or_error = llvm::sys::fs::TempFile::create(cache.entry_path + ".tmp%%%%%%%");
+    if (!temporary_or_error)
+    {
+        llvm::consumeError(temporary_or_error.takeError());
+        return;
+    }
+
+    LLDCacheEntryHeader header = {
+        .magic = LLD_CACHE_ENTRY_MAGIC,
+        .manifest_length = manifest.size(),
+        .stdout_length = stdout_text.size(),
+        .stderr_length = stderr_text.size(),
+        .output_length = output.size(),
+    };
+
+    {
+        llvm::raw_fd_ostream stream(temporary_or_error->FD, /* shouldClose */ false);
+        stream << llvm::StringRef((const char*)&header, sizeof(header)) << manifest << stdout_text << stderr_text << output;
+        stream.flush();
+        if (stream.has_error())
+        {
+            stream.clear_error();
+            llvm::consumeError(temporary_or_error->discard());
+            return;
+        }
+    }
+
+    // Concurrent links may race to store the same key; whichever rename lands last wins, and both are identical.
+    if (auto error = temporary_or_error->keep(cache.entry_path))
+    {
+        llvm::consumeError(std::move(error));
+        return;
+    }
+
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::seconds(0);
+    policy.Expiration = std::chrono::seconds(0);
+    // Only the size limit applies; LLVM's defaults would also prune by free disk space and file count.
+    policy.MaxSizeBytes = options->cache_size_limit;
+    policy.MaxSizePercentageOfAvailableSpace = 0;
+    policy.MaxSizeFiles = 0;
+    llvm::pruneCache(cache_directory, policy);
+}
+
+fn void lld_cache_finish(const LLDCacheLink& cache)
+{
+    if (!cache.dependency_path.empty() && !cache.dependency_path_requested)
+    {
+        llvm::sys::fs::remove(cache.dependency_path);
+    }
+}
+
+// lld keeps its per-link state behind a process-global context, so in-process links are serialized and a link can
+// only start once the previous context is gone. Sessions hand the destruction to a background task and every link
+// joins it before starting.
+static std::mutex link_mutex;
+static std::future<void> pending_teardown;
+static std::atomic<bool> linked_in_process;
+
+fn void lld_teardown_wait()
+{
+    if (pending_teardown.valid())
+    {
+        pending_teardown.get();
+    }
+}
+
+// Called with the link mutex held, right after the link.
+fn void lld_teardown_defer(llvm::SmallString<128> staging_directory)
+{
+    // lld's error handler still points at the link's stdout and stderr streams, which are gone by the time the context
+    // is destroyed, so anything the teardown reports is dropped instead.
+    if (lld::hasContext())
+    {
+        lld::errorHandler().initialize(llvm::nulls(), llvm::nulls(), /* exitEarly */ false, /* disableOutput */ true);
+    }
+
+    pending_teardown = std::async(std::launch::async, [staging_directory = std::move(staging_directory)]()
+    {
+        lld::CommonLinkerContext::destroy();
+        if (!staging_directory.empty())
+        {
+            llvm::sys::fs::remove_directories(staging_directory);
+        }
+    });
+}
+
+fn LinkerFunction* lld_flavor_linker_function(LLDFlavor flavor)
+{
+    switch (flavor)
+    {
+        case LLD_FLAVOR_COFF: return lld::coff::link;
+        case LLD_FLAVOR_ELF: return lld::elf::link;
+        case LLD_FLAVOR_MINGW: return lld::mingw::link;
+        case LLD_FLAVOR_MACHO: return lld::macho::link;
+        case LLD_FLAVOR_WASM: return lld::wasm::link;
+    }
+
+    return nullptr;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Worker processes are forked from the host and link one request at a time with their own copy of lld's global
+// state, so links dispatched to different workers run in parallel. Requests and responses are sequences of
+// u64-length-prefixed records over a socket pair.
+struct LLDWorker
+{
+    pid_t pid;
+    int fd;
+};
+
+struct LLDWorkerPool
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<LLDWorker> workers;
+    std::vector<u32> idle;
+};
+
+static LLDWorkerPool worker_pool;
+static std::atomic<u32> worker_count;
+
+fn bool lld_fd_write(int fd, const void* pointer, u64 length)
+{
+    auto* bytes = (const u8*)pointer;
+    while (length)
+    {
+#if defined(MSG_NOSIGNAL)
+        auto written = send(fd, bytes, length, MSG_NOSIGNAL);
+#else
+        auto written = write(fd, bytes, length);
+#endif
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        bytes += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+fn bool lld_fd_read(int fd, void* pointer, u64 length)
+{
+    auto* bytes = (u8*)pointer;
+    while (length)
+    {
+        auto bytes_read = read(fd, bytes, length);
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (bytes_read <= 0)
+        {
+            return false;
+        }
+
+        bytes += bytes_read;
+        length -= bytes_read;
+    }
+
+    return true;
+}
+
+fn bool lld_fd_write_u64(int fd, u64 value)
+{
+    return lld_fd_write(fd, &value, sizeof(value));
+}
+
+fn bool lld_fd_write_record(int fd, llvm::StringRef record)
+{
+    return lld_fd_write_u64(fd, record.size()) && lld_fd_write(fd, record.data(), record.size());
+}
+
+fn bool lld_fd_read_u64(int fd, u64& value)
+{
+    return lld_fd_read(fd, &value, sizeof(value));
+}
+
+fn bool lld_fd_read_record(int fd, std::string& record)
+{
+    u64 length;
+    if (!lld_fd_read_u64(fd, length))
+    {
+        return false;
+    }
+
+    record.resize(length);
+    return lld_fd_read(fd, record.data(), length);
+}
+
+// Links in a child forked from the worker for this one link, whose address space acts as the link's arena: lld exits
+// from inside the call once the output is written, so the OS releases all of its memory at once and the worker never
+// pays for CommonLinkerContext::destroy. The worker itself stays single-threaded until it links in process, so the
+// fork is safe; after that, its copy of lld's parallel executor has no threads behind it and the child links with one
+// thread.
+fn bool lld_worker_arena_link(int fd, LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, llvm::raw_ostream& stdout_stream, llvm::raw_ostream& stderr_stream, bool disable_output, bool single_threaded)
+{
+    int stdout_pipe[2];
+    int stderr_pipe[2];
+    if (pipe(stdout_pipe) != 0)
+    {
+        stderr_stream << "error: cannot create pipe for arena link\n";
+        return false;
+    }
+
+    if (pipe(stderr_pipe) != 0)
+    {
+        close(stdout_pipe[0]);
+        close(stdout_pipe[1]);
+        stderr_stream << "error: cannot create pipe for arena link\n";
+        return false;
+    }
+
+    auto pid = fork();
+    if (pid == 0)
+    {
+        // The host has to see end-of-file on the socket when the worker dies, even while a child is still linking.
+        close(fd);
+        close(stdout_pipe[0]);
+        close(stderr_pipe[0]);
+
+        std::vector<const char*> child_arguments(arguments.begin(), arguments.end());
+        if (single_threaded)
+        {
+            child_arguments.push_back(flavor == LLD_FLAVOR_COFF ? "/threads:1" : "--threads=1");
+        }
+
+        bool success = false;
+        {
+            llvm::raw_fd_ostream child_stdout(stdout_pipe[1], /* shouldClose */ true);
+            llvm::raw_fd_ostream child_stderr(stderr_pipe[1], /* shouldClose */ true);
+            auto* linker_function = lld_flavor_linker_function(flavor);
+            // With exitEarly lld flushes the streams and exits from inside the call once the output is written.
+            success = linker_function && linker_function(child_arguments, child_stdout, child_stderr, /* exitEarly */ true, disable_output);
+        }
+
+        _exit(success ? 0 : 1);
+    }
+
+    close(stdout_pipe[1]);
+    close(stderr_pipe[1]);
+
+    if (pid < 0)
+    {
+        close(stdout_pipe[0]);
+        close(stderr_pipe[0]);
+        stderr_stream << "error: cannot fork for arena link\n";
+        return false;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = stdout_pipe[0], .events = POLLIN },
+        { .fd = stderr_pipe[0], .events = POLLIN },
+    };
+    llvm::raw_ostream* streams[2] = { &stdout_stream, &stderr_stream };
+    u32 open_count = 2;
+    char buffer[64 * 1024];
+
+    while (open_count)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        for (u32 i = 0; i < 2; i += 1)
+        {
+            if (fds[i].fd >= 0 && fds[i].revents)
+            {
+                auto bytes_read = read(fds[i].fd, buffer, sizeof(buffer));
+                if (bytes_read > 0)
+                {
+                    streams[i]->write(buffer, bytes_read);
+                }
+                else if (bytes_read == 0 || errno != EINTR)
+                {
+                    close(fds[i].fd);
+                    fds[i].fd = -1;
+                    open_count -= 1;
+                }
+            }
+        }
+    }
+
+    for (auto& poll_fd : fds)
+    {
+        if (poll_fd.fd >= 0)
+        {
+            close(poll_fd.fd);
+        }
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+
+    if (WIFSIGNALED(status))
+    {
+        stderr_stream << "error: arena link process terminated by signal " << WTERMSIG(status) << "\n";
+        return false;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+[[noreturn]] fn void lld_worker_main(int fd)
+{
+    std::vector<std::string> argument_strings;
+    std::vector<const char*> arguments;
+    std::string working_directory;
+    std::string stdout_string;
+    std::string stderr_string;
+    bool linked_in_worker = false;
+
+    while (true)
+    {
+        u64 flavor;
+        u64 disable_output;
+        u64 arena;
+        u64 argument_count;
+        if (!lld_fd_read_record(fd, working_directory) || !lld_fd_read_u64(fd, flavor) || !lld_fd_read_u64(fd, disable_output) || !lld_fd_read_u64(fd, arena) || !lld_fd_read_u64(fd, argument_count))
+        {
+            _exit(0);
+        }
+
+        argument_strings.resize(argument_count);
+        arguments.resize(argument_count);
+        for (u64 i = 0; i < argument_count; i += 1)
+        {
+            if (!lld_fd_read_record(fd, argument_strings[i]))
+            {
+                _exit(1);
+            }
+
+            arguments[i] = argument_strings[i].c_str();
+        }
+
+        stdout_string.clear();
+        stderr_string.clear();
+        bool success = false;
+        {
+            llvm::raw_string_ostream stdout_stream(stdout_string);
+            llvm::raw_string_ostream stderr_stream(stderr_string);
+            if (chdir(working_directory.c_str()) != 0)
+            {
+                stderr_stream << "error: linker worker process cannot change to " << working_directory << ": " << std::error_code(errno, std::generic_category()).message() << "\n";
+            }
+            else if (arena)
+            {
+                success = lld_worker_arena_link(fd, (LLDFlavor)flavor, arguments, stdout_stream, stderr_stream, disable_output, linked_in_worker);
+            }
+            else
+            {
+                auto* linker_function = lld_flavor_linker_function((LLDFlavor)flavor);
+                success = linker_function && linker_function(arguments, stdout_stream, stderr_stream, false, disable_output);
+                lld::CommonLinkerContext::destroy();
+                linked_in_worker = true;
+            }
+        }
+
+        if (!lld_fd_write_u64(fd, success) || !lld_fd_write_record(fd, stdout_string) || !lld_fd_write_record(fd, stderr_string))
+        {
+            _exit(1);
+        }
+    }
+}
+
+// Called with the link mutex and the pool mutex held.
+fn bool lld_worker_spawn(LLDWorker& worker)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        return false;
+    }
+
+#if defined(SO_NOSIGPIPE)
+    int enable = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+
+    auto pid = fork();
+    if (pid == 0)
+    {
+        // Other workers must only see end-of-file when the host closes its side, so drop their descriptors.
+        for (auto& other : worker_pool.workers)
+        {
+            if (other.fd >= 0)
+            {
+                close(other.fd);
+            }
+        }
+
+        close(fds[0]);
+        lld_worker_main(fds[1]);
+    }
+
+    close(fds[1]);
+
+    if (pid < 0)
+    {
+        close(fds[0]);
+        return false;
+    }
+
+    worker.pid = pid;
+    worker.fd = fds[0];
+    return true;
+}
+
+// Called with the pool mutex held.
+fn void lld_worker_kill(LLDWorker& worker)
+{
+    if (worker.fd >= 0)
+    {
+        close(worker.fd);
+        worker.fd = -1;
+    }
+
+    if (worker.pid > 0)
+    {
+        while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR)
+        {
+        }
+
+        worker.pid = -1;
+    }
+}
+
+// Sends a link request to a worker process and forwards its diagnostics. Returns false if the worker went away
+// before answering. Workers are forked once and never see a later chdir of the host, so every request carries the
+// host's working directory, against which the worker resolves relative paths.
+fn bool lld_remote_link(int fd, LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, llvm::raw_ostream& stdout_stream, llvm::raw_ostream& stderr_stream, bool disable_output, bool arena, bool& success)
+{
+    llvm::SmallString<256> working_directory;
+    if (auto error_code = llvm::sys::fs::current_path(working_directory))
+    {
+        stderr_stream << "error: cannot get the working directory: " << error_code.message() << "\n";
+        success = false;
+        return true;
+    }
+
+    bool sent = lld_fd_write_record(fd, working_directory) && lld_fd_write_u64(fd, flavor) && lld_fd_write_u64(fd, disable_output) && lld_fd_write_u64(fd, arena) && lld_fd_write_u64(fd, arguments.size());
+    for (u64 i = 0; sent && i < arguments.size(); i += 1)
+    {
+        sent = lld_fd_write_record(fd, arguments[i]);
+    }
+
+    u64 remote_success = 0;
+    std::string stdout_string;
+    std::string stderr_string;
+    bool received = sent && lld_fd_read_u64(fd, remote_success) && lld_fd_read_record(fd, stdout_string) && lld_fd_read_record(fd, stderr_string);
+
+    stdout_stream << stdout_string;
+    stderr_stream << stderr_string;
+
+    success = received && remote_success;
+    return received;
+}
+
+fn bool lld_worker_link(LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, llvm::raw_ostream& stdout_stream, llvm::raw_ostream& stderr_stream, bool disable_output, bool arena)
+{
+    bool success = false;
+    u32 worker_index;
+    {
+        std::unique_lock lock(worker_pool.mutex);
+        worker_pool.condition.wait(lock, []() { return !worker_pool.idle.empty() || worker_count == 0; });
+        if (worker_pool.idle.empty())
+        {
+            stderr_stream << "error: no linker worker process is available\n";
+            return false;
+        }
+
+        worker_index = worker_pool.idle.back();
+        worker_pool.idle.pop_back();
+    }
+
+    auto& worker = worker_pool.workers[worker_index];
+    bool received = lld_remote_link(worker.fd, flavor, arguments, stdout_stream, stderr_stream, disable_output, arena, success);
+
+    {
+        std::lock_guard lock(worker_pool.mutex);
+
+        if (!received)
+        {
+            // The worker crashed mid-link. Forking a replacement from this thread would copy a host that may be in the
+            // middle of anything, so the pool shrinks instead until lld_set_worker_process_count is called again.
+            stderr_stream << "error: linker worker process terminated unexpectedly\n";
+            lld_worker_kill(worker);
+            worker_count -= 1;
+            worker_pool.condition.notify_all();
+            return false;
+        }
+
+        worker_pool.idle.push_back(worker_index);
+    }
+
+    worker_pool.condition.notify_one();
+
+    return success;
+}
+
+BB_EXPORT bool lld_set_worker_process_count(u32 count)
+{
+    // A fork only carries over the calling thread, so a child forked after lld has started its parallel executor
+    // would wait forever on threads that do not exist in it. The link mutex stays held until the workers are forked,
+    // so no in-process link can start in between.
+    std::lock_guard link_lock(link_mutex);
+    if (count && linked_in_process)
+    {
+        return false;
+    }
+
+    std::unique_lock lock(worker_pool.mutex);
+
+    // Let in-flight links finish before the pool changes shape.
+    worker_pool.condition.wait(lock, []() { return worker_pool.idle.size() == worker_count; });
+
+    for (auto& worker : worker_pool.workers)
+    {
+        lld_worker_kill(worker);
+    }
+
+    worker_pool.workers.clear();
+    worker_pool.idle.clear();
+    worker_count = 0;
+
+    worker_pool.workers.reserve(count);
+    for (u32 i = 0; i < count; i += 1)
+    {
+        LLDWorker worker = { .pid = -1, .fd = -1 };
+        if (!lld_worker_spawn(worker))
+        {
+            break;
+        }
+
+        worker_pool.workers.push_back(worker);
+        worker_pool.idle.push_back(i);
+        worker_count += 1;
+    }
+
+    return worker_count == count;
+}
+#else
+static std::atomic<u32> worker_count;
+
+fn bool lld_worker_link(LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, llvm::raw_ostream& stdout_stream, llvm::raw_ostream& stderr_stream, bool disable_output, bool arena)
+{
+    return false;
+}
+
+BB_EXPORT bool lld_set_worker_process_count(u32 count)
+{
+    return count == 0;
+}
+#endif
+
+// Phase timings come from the time-trace scopes lld already opens around its phases. The profiler is only started
+// when the caller did not request its own trace, since lld would then start one itself, and when the host has not
+// already started one on this thread, which would otherwise be written out and torn down under it.
+fn bool lld_stats_profile_begin(llvm::ArrayRef<const char*> arguments)
+{
+    if (llvm::timeTraceProfilerEnabled())
+    {
+        return false;
+    }
+
+    for (u64 i = 1; i < arguments.size(); i += 1)
+    {
+        auto argument = llvm::StringRef(arguments[i]).ltrim("-/");
+        if (argument.starts_with("time-trace"))
+        {
+            return false;
+        }
+    }
+
+    llvm::timeTraceProfilerInitialize(/* TimeTraceGranularity */ 500, "lld");
+    return true;
+}
+
+fn void lld_stats_profile_end(LLDLinkStats& stats, LldAllocationFn* allocate_fn, void* context)
+{
+    llvm::SmallString<0> trace;
+    llvm::raw_svector_ostream trace_stream(trace);
+    llvm::timeTraceProfilerWrite(trace_stream);
+    llvm::timeTraceProfilerCleanup();
+
+    auto json_or_error = llvm::json::parse(trace);
+    if (!json_or_error)
+    {
+        llvm::consumeError(json_or_error.takeError());
+        return;
+    }
+
+    auto* events = json_or_error->getAsObject() ? json_or_error->getAsObject()->getArray("traceEvents") : nullptr;
+    if (!events)
+    {
+        return;
+    }
+
+    // The profiler appends one "Total <name>" event per scope name with the summed duration in microseconds.
+    llvm::SmallVector<std::pair<llvm::StringRef, u64>> phases;
+    for (auto& event : *events)
+    {
+        auto* object = event.getAsObject();
+        if (!object)
+        {
+            continue;
+        }
+
+        auto name = object->getString("name");
+        auto duration = object->getInteger("dur");
+        if (name && duration && name->starts_with("Total "))
+        {
+            phases.push_back({ name->drop_front(strlen("Total ")), (u64)*duration * 1000 });
+        }
+    }
+
+    if (phases.empty())
+    {
+        return;
+    }
+
+    stats.phase_pointer = (LLDPhaseTiming*)allocate_fn(context, phases.size() * sizeof(LLDPhaseTiming), alignof(LLDPhaseTiming));
+    stats.phase_count = phases.size();
+    for (u64 i = 0; i < phases.size(); i += 1)
+    {
+        stats.phase_pointer[i].name = lld_copy_string(phases[i].first.str(), allocate_fn, context);
+        stats.phase_pointer[i].nanoseconds = phases[i].second;
+    }
+}
+
+fn void lld_link_job_output(LLDLinkJob& job, LLDResult& result, bool disable_output, LldAllocationFn* allocate_fn, void* context, llvm::raw_ostream& stderr_stream)
+{
+    if (result.success && job.output_path && !disable_output)
+    {
+        result.output = lld_read_output(job, allocate_fn, context, stderr_stream);
+        result.success = result.output.pointer != nullptr;
+    }
+}
+
+fn LLDResult lld_link_job_run(LLDLinkJob& job, LLDFlavor flavor, llvm::ArrayRef<const char*> arguments, const LLDLinkOptions* options, std::string& stdout_string, std::string& stderr_string, bool exit_early, bool disable_output, LldAllocationFn* allocate_fn, void* context, LinkerFunction linker_function, bool defer_teardown)
+{
+    LLDResult result = {};
+
+    stdout_string.clear();
+    llvm::raw_string_ostream stdout_string_stream(stdout_string);
+
+    stderr_string.clear();
+    llvm::raw_string_ostream stderr_string_stream(stderr_string);
+
+    std::optional<LLDCallbackStream> stdout_callback_stream;
+    std::optional<LLDCallbackStream> stderr_callback_stream;
+    llvm::raw_ostream* stdout_stream_pointer = &stdout_string_stream;
+    llvm::raw_ostream* stderr_stream_pointer = &stderr_string_stream;
+    // Streamed diagnostics still have to be kept aside when the link result is going to be cached.
+    bool streaming = options && options->write_fn;
+    bool caching = options && options->cache_directory.length;
+    std::string stdout_copy;
+    std::string stderr_copy;
+    if (streaming)
+    {
+        stdout_stream_pointer = &stdout_callback_stream.emplace(options->write_fn, options->write_context, LLD_OUTPUT_STREAM_STDOUT, caching ? &stdout_copy : nullptr);
+        stderr_stream_pointer = &stderr_callback_stream.emplace(options->write_fn, options->write_context, LLD_OUTPUT_STREAM_STDERR, caching ? &stderr_copy : nullptr);
+    }
+
+    auto& stdout_stream = *stdout_stream_pointer;
+    auto& stderr_stream = *stderr_stream_pointer;
+
+    LLDCacheLink cache;
+    bool cacheable = false;
+
+    auto* stats = options ? options->stats : nullptr;
+    llvm::sys::TimePoint<> start_wall_time;
+    std::chrono::nanoseconds start_user_time;
+    std::chrono::nanoseconds start_system_time;
+    if (stats)
+    {
+        *stats = {};
+        llvm::sys::Process::GetTimeUsage(start_wall_time, start_user_time, start_system_time);
+    }
+
+    if (!lld_link_job_prepare(job, flavor, arguments, options, stderr_stream))
+    {
+        lld_link_job_finish(job);
+    }
+    else if ((cacheable = lld_cache_entry(job, flavor, options, disable_output, cache)) && lld_cache_lookup(cache, result, stdout_stream, stderr_stream, allocate_fn, context))
+    {
+        cacheable = false;
+        lld_link_job_finish(job);
+    }
+    else if (options && options->arena_teardown && !worker_count)
+    {
+        stderr_stream << "error: arena teardown runs links in worker processes, but none are running (see lld_set_worker_process_count)\n";
+        lld_link_job_finish(job);
+    }
+    else if (worker_count)
+    {
+        result.success = lld_worker_link(flavor, job.arguments, stdout_stream, stderr_stream, disable_output, options && options->arena_teardown);
+        lld_link_job_output(job, result, disable_output, allocate_fn, context, stderr_stream);
+        lld_link_job_finish(job);
+    }
+    else
+    {
+        std::lock_guard lock(link_mutex);
+        lld_teardown_wait();
+        linked_in_process = true;
+
+        bool profiling = stats && lld_stats_profile_begin(job.arguments);
+
+        result.success = linker_function(job.arguments, stdout_stream, stderr_stream, exit_early, disable_output);
+
+        if (stats)
+        {
+            if (lld::hasContext())
+            {
+                stats->bump_allocator_bytes = lld::commonContext().bAlloc.getTotalMemory();
+            }
+
+            stats->thread_count = llvm::parallel::strategy.compute_thread_count();
+
+            if (profiling)
+            {
+                lld_stats_profile_end(*stats, allocate_fn, context);
+            }
+        }
+
+        lld_link_job_output(job, result, disable_output, allocate_fn, context, stderr_stream);
+
+        if (defer_teardown)
+        {
+            lld_teardown_defer(std::move(job.staging_directory));
+        }
+        else
+        {
+            // A failed link leaves lld's context behind just like a successful one, and the next link needs it gone.
+            lld::CommonLinkerContext::destroy();
+            lld_link_job_finish(job);
+        }
+    }
+
+    if (stats)
+    {
+        llvm::sys::TimePoint<> end_wall_time;
+        std::chrono::nanoseconds end_user_time;
+        std::chrono::nanoseconds end_system_time;
+        llvm::sys::Process::GetTimeUsage(end_wall_time, end_user_time, end_system_time);
+        stats->wall_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end_wall_time - start_wall_time).count();
+        stats->cpu_nanoseconds = ((end_user_time - start_user_time) + (end_system_time - start_system_time)).count();
+
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+#if defined(__APPLE__)
+            stats->peak_resident_bytes = usage.ru_maxrss;
+#else
+            stats->peak_resident_bytes = (u64)usage.ru_maxrss * 1024;
+#endif
+        }
+#endif
+    }
+
+    stdout_stream.flush();
+    stderr_stream.flush();
+
+    if (cacheable)
+    {
+        if (result.success)
+        {
+            lld_cache_store(cache, options, result, streaming ? stdout_copy : stdout_string, streaming ? stderr_copy : stderr_string);
+        }
+
+        lld_cache_finish(cache);
+    }
+
+    result.stdout_string = lld_copy_string(stdout_string, allocate_fn, context);
+    result.stderr_string = lld_copy_string(stderr_string, allocate_fn, context);
+
+    return result;
+}
+
+fn LLDResult lld_api_generic(lld_api_args(), const LLDLinkOptions* options, LLDFlavor flavor, LinkerFunction linker_function)
+{
+    auto arguments = llvm::ArrayRef(argument_pointer, argument_count);
+
+    LLDLinkJob job;
+    std::string stdout_string;
+    std::string stderr_string;
+    return lld_link_job_run(job, flavor, arguments, options, stdout_string, stderr_string, exit_early, disable_output, allocate_fn, context, linker_function, false);
+}
+
+struct LLDLockedAllocator
+{
+    std::mutex* mutex;
+    LldAllocationFn* allocate_fn;
+    void* context;
+};
+
+fn u8* lld_locked_allocate(void* context, u64 size, u64 alignment)
+{
+    auto* allocator = (LLDLockedAllocator*)context;
+    std::lock_guard lock(*allocator->mutex);
+    return allocator->allocate_fn(allocator->context, size, alignment);
+}
+
+#define lld_api_function_impl(link_name, flavor) \
+BB_EXPORT lld_api_function_decl(link_name)\
+{\
+    return lld_api_generic(argument_pointer, argument_count, exit_early, disable_output, allocate_fn, context, nullptr, flavor, lld::link_name::link);\
+}\
+\
+BB_EXPORT lld_api_function_ex_decl(link_name)\
+{\
+    return lld_api_generic(argument_pointer, argument_count, exit_early, disable_output, allocate_fn, context, options, flavor, lld::link_name::link);\
+}
+
+lld_api_function_impl(coff, LLD_FLAVOR_COFF)
+lld_api_function_impl(elf, LLD_FLAVOR_ELF)
+lld_api_function_impl(mingw, LLD_FLAVOR_MINGW)
+lld_api_function_impl(macho, LLD_FLAVOR_MACHO)
+lld_api_function_impl(wasm, LLD_FLAVOR_WASM)
+
+struct LLDSession
+{
+    LLDFlavor flavor;
+    LinkerFunction* linker_function;
+    std::string stdout_string;
+    std::string stderr_string;
+};
+
+BB_EXPORT LLDSession* lld_session_create(LLDFlavor flavor)
+{
+    auto* linker_function = lld_flavor_linker_function(flavor);
+    if (!linker_function)
+    {
+        return nullptr;
+    }
+
+    auto* session = new LLDSession();
+    session->flavor = flavor;
+    session->linker_function = linker_function;
+    return session;
+}
+
+BB_EXPORT LLDResult lld_session_link(lld_session_args())
+{
+    auto arguments = llvm::ArrayRef(argument_pointer, argument_count);
+    LLDLinkJob job;
+    // Exiting early would take the host process down with it, which defeats the point of keeping a session.
+    return lld_link_job_run(job, session->flavor, arguments, options, session->stdout_string, session->stderr_string, false, disable_output, allocate_fn, context, session->linker_function, true);
+}
+
+BB_EXPORT void lld_session_destroy(LLDSession* session)
+{
+    std::lock_guard lock(link_mutex);
+    lld_teardown_wait();
+    delete session;
+}
+
+struct LLDLinkHandle
+{
+    LLDFlavor flavor;
+    llvm::BumpPtrAllocator allocator;
+    llvm::StringSaver saver{allocator};
+    std::vector<const char*> arguments;
+    LLDLinkOptions options;
+    bool has_options;
+    bool disable_output;
+    LLDLockedAllocator result_allocator;
+    LldCompletionFn* completion_fn;
+    void* completion_context;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done;
+    // The handle cannot be released while its completion function is still using it.
+    bool completing;
+    LLDResult result;
+};
+
+struct LLDAsyncPool
+{
+    std::mutex configuration_mutex;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<LLDLinkHandle*> queue;
+    std::vector<std::thread> threads;
+    bool stopping;
+
+    ~LLDAsyncPool();
+};
+
+static std::mutex async_allocation_mutex;
+static LLDAsyncPool async_pool;
+static thread_local bool is_async_pool_thread;
+
+fn void lld_async_run(LLDLinkHandle& handle)
+{
+    auto* options = handle.has_options ? &handle.options : nullptr;
+    std::string stdout_string;
+    std::string stderr_string;
+    LLDLinkJob job;
+    auto result = lld_link_job_run(job, handle.flavor, handle.arguments, options, stdout_string, stderr_string, false, handle.disable_output, lld_locked_allocate, &handle.result_allocator, lld_flavor_linker_function(handle.flavor), false);
+
+    // A waiter may release the handle as soon as it can take the mutex and see the link finished, so the handle is
+    // notified with the mutex held and not touched again once it is unlocked.
+    auto* completion_fn = handle.completion_fn;
+    {
+        std::lock_guard lock(handle.mutex);
+        handle.result = result;
+        handle.done = true;
+        handle.completing = completion_fn != nullptr;
+        handle.condition.notify_all();
+    }
+
+    if (completion_fn)
+    {
+        completion_fn(handle.completion_context, &handle);
+
+        std::lock_guard lock(handle.mutex);
+        handle.completing = false;
+        handle.condition.notify_all();
+    }
+}
+
+fn void lld_async_thread()
+{
+    is_async_pool_thread = true;
+
+    while (true)
+    {
+        LLDLinkHandle* handle;
+        {
+            std::unique_lock lock(async_pool.mutex);
+            async_pool.condition.wait(lock, []() { return !async_pool.queue.empty() || async_pool.stopping; });
+            if (async_pool.queue.empty())
+            {
+                return;
+            }
+
+            handle = async_pool.queue.front();
+            async_pool.queue.pop_front();
+        }
+
+        lld_async_run(*handle);
+    }
+}
+
+// Called with the configuration mutex held. Queued links are drained before the threads exit.
+fn void lld_async_stop()
+{
+    {
+        std::lock_guard lock(async_pool.mutex);
+        async_pool.stopping = true;
+    }
+
+    async_pool.condition.notify_all();
+
+    for (auto& thread : async_pool.threads)
+    {
+        thread.join();
+    }
+
+    async_pool.threads.clear();
+    async_pool.stopping = false;
+}
+
+// Called with the configuration mutex held.
+fn void lld_async_start(u32 count)
+{
+    for (u32 i = 0; i < count; i += 1)
+    {
+        async_pool.threads.emplace_back(lld_async_thread);
+    }
+}
+
+LLDAsyncPool::~LLDAsyncPool()
+{
+    std::lock_guard lock(configuration_mutex);
+    lld_async_stop();
+}
+
+BB_EXPORT void lld_set_async_thread_count(u32 count)
+{
+    std::lock_guard lock(async_pool.configuration_mutex);
+    lld_async_stop();
+    lld_async_start(std::max<u32>(count, 1));
+}
+
+BB_EXPORT LLDLinkHandle* lld_link_async(LLDFlavor flavor, char* const* argument_pointer, u64 argument_count, bool disable_output, LldAllocationFn* allocate_fn, void* context, const LLDLinkOptions* options, LldCompletionFn* completion_fn, void* completion_context)
+{
+    if (!lld_flavor_linker_function(flavor))
+    {
+        return nullptr;
+    }
+
+    auto* handle = new LLDLinkHandle();
+    handle->flavor = flavor;
+    handle->arguments.reserve(argument_count);
+    for (u64 i = 0; i < argument_count; i += 1)
+    {
+        handle->arguments.push_back(handle->saver.save(argument_pointer[i]).data());
+    }
+
+    if (options)
+    {
+        handle->options = *options;
+        handle->has_options = true;
+    }
+
+    handle->disable_output = disable_output;
+    handle->result_allocator.mutex = &async_allocation_mutex;
+    handle->result_allocator.allocate_fn = allocate_fn;
+    handle->result_allocator.context = context;
+    handle->completion_fn = completion_fn;
+    handle->completion_context = completion_context;
+
+    if (is_async_pool_thread)
+    {
+        // Queued from a completion function. The pool is running, but lld_set_async_thread_count may be joining this
+        // very thread with the configuration mutex held, so it is not taken here. Stopping threads drain the queue
+        // before they exit, which still runs this link.
+        std::lock_guard lock(async_pool.mutex);
+        async_pool.queue.push_back(handle);
+    }
+    else
+    {
+        std::lock_guard configuration_lock(async_pool.configuration_mutex);
+        if (async_pool.threads.empty())
+        {
+            lld_async_start(std::max<u32>(worker_count, 1));
+        }
+
+        std::lock_guard lock(async_pool.mutex);
+        async_pool.queue.push_back(handle);
+    }
+
+    async_pool.condition.notify_one();
+
+    return handle;
+}
+
+BB_EXPORT bool lld_link_poll(LLDLinkHandle* handle)
+{
+    std::lock_guard lock(handle->mutex);
+    return handle->done;
+}
+
+BB_EXPORT LLDResult lld_link_wait(LLDLinkHandle* handle)
+{
+    LLDResult result;
+    {
+        std::unique_lock lock(handle->mutex);
+        handle->condition.wait(lock, [handle]() { return handle->done && !handle->completing; });
+        result = handle->result;
+    }
+
+    delete handle;
+    return result;
+}
+
+struct LLDJit
+{
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+};
+
+fn llvm::Expected<std::unique_ptr<LLDJit>> lld_jit_create()
+{
+    static std::once_flag target_initialization;
+    std::call_once(target_initialization, []()
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setObjectLinkingLayerCreator([](llvm::orc::ExecutionSession& session) -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>>
+    {
+        return std::make_unique<llvm::orc::ObjectLinkingLayer>(session);
+    });
+
+    auto jit_or_error = builder.create();
+    if (!jit_or_error)
+    {
+        return jit_or_error.takeError();
+    }
+
+    auto result = std::make_unique<LLDJit>();
+    result->jit = std::move(*jit_or_error);
+
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(result->jit->getDataLayout().getGlobalPrefix());
+    if (!generator)
+    {
+        return generator.takeError();
+    }
+
+    result->jit->getMainJITDylib().addGenerator(std::move(*generator));
+    return result;
+}
+
+// Objects are added as a whole and their global definitions recorded; archives and shared libraries only serve
+// symbols that are looked up.
+fn llvm::Error lld_jit_add_input(LLDJit& jit, std::unique_ptr<llvm::MemoryBuffer> buffer, std::vector<std::string>& defined_symbols)
+{
+    auto& main_library = jit.jit->getMainJITDylib();
+    auto magic = llvm::identify_magic(buffer->getBuffer());
+
+    switch (magic)
+    {
+        case llvm::file_magic::archive:
+        {
+            auto generator = llvm::orc::StaticLibraryDefinitionGenerator::Create(jit.jit->getObjLinkingLayer(), std::move(buffer));
+            if (!generator)
+            {
+                return generator.takeError();
+            }
+
+            main_library.addGenerator(std::move(*generator));
+            return llvm::Error::success();
+        }
+        case llvm::file_magic::elf_shared_object:
+        case llvm::file_magic::macho_dynamically_linked_shared_lib:
+        {
+            auto generator = llvm::orc::DynamicLibrarySearchGenerator::Load(buffer->getBufferIdentifier().str().c_str(), jit.jit->getDataLayout().getGlobalPrefix());
+            if (!generator)
+            {
+                return generator.takeError();
+            }
+
+            main_library.addGenerator(std::move(*generator));
+            return llvm::Error::success();
+        }
+        default:
+        {
+            auto object = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+            if (!object)
+            {
+                return object.takeError();
+            }
+
+            for (auto& symbol : (*object)->symbols())
+            {
+                auto flags = symbol.getFlags();
+                if (!flags)
+                {
+                    return flags.takeError();
+                }
+
+                if ((*flags & llvm::object::SymbolRef::SF_Global) && !(*flags & llvm::object::SymbolRef::SF_Undefined))
+                {
+                    auto name = symbol.getName();
+                    if (!name)
+                    {
+                        return name.takeError();
+                    }
+
+                    defined_symbols.push_back(name->str());
+                }
+            }
+
+            return jit.jit->addObjectFile(std::move(buffer));
+        }
+    }
+}
+
+BB_EXPORT LLDJitResult lld_jit_link(char* const* argument_pointer, u64 argument_count, const LLDLinkOptions* options, LldAllocationFn* allocate_fn, void* context)
+{
+    LLDJitResult result = {};
+    std::string stderr_string;
+    llvm::raw_string_ostream stderr_stream(stderr_string);
+
+    auto jit_or_error = lld_jit_create();
+    if (!jit_or_error)
+    {
+        stderr_stream << "error: cannot create JIT: " << llvm::toString(jit_or_error.takeError()) << "\n";
+        result.stderr_string = lld_copy_string(stderr_string, allocate_fn, context);
+        return result;
+    }
+
+    auto jit = std::move(*jit_or_error);
+    std::vector<std::string> defined_symbols;
+    bool success = true;
+
+    // Session errors (such as undefined symbols) would otherwise go straight to the host's stderr.
+    jit->jit->getExecutionSession().setErrorReporter([&](llvm::Error error)
+    {
+        stderr_stream << "error: " << llvm::toString(std::move(error)) << "\n";
+    });
+
+    for (u64 i = 1; i < argument_count; i += 1)
+    {
+        llvm::StringRef argument = argument_pointer[i];
+        if (argument.starts_with("-"))
+        {
+            stderr_stream << "error: unsupported option for JIT link: " << argument << "\n";
+            success = false;
+            continue;
+        }
+
+        auto buffer = llvm::MemoryBuffer::getFile(argument, /* IsText */ false, /* RequiresNullTerminator */ false);
+        if (!buffer)
+        {
+            stderr_stream << "error: cannot open " << argument << ": " << buffer.getError().message() << "\n";
+            success = false;
+            continue;
+        }
+
+        if (auto error = lld_jit_add_input(*jit, std::move(*buffer), defined_symbols))
+        {
+            stderr_stream << "error: " << argument << ": " << llvm::toString(std::move(error)) << "\n";
+            success = false;
+        }
+    }
+
+    if (options)
+    {
+        for (auto& input : llvm::ArrayRef(options->input_buffer_pointer, options->input_buffer_count))
+        {
+            auto name = llvm::StringRef(input.name.pointer, input.name.length);
+            auto bytes = llvm::StringRef((const char*)input.bytes.pointer, input.bytes.length);
+
+            // Shared libraries are handed to the dynamic loader, which only loads files by path; with a buffer it would
+            // fail with a dlopen error about a file named after the buffer.
+            auto magic = llvm::identify_magic(bytes);
+            if (magic == llvm::file_magic::elf_shared_object || magic == llvm::file_magic::macho_dynamically_linked_shared_lib)
+            {
+                stderr_stream << "error: " << name << ": shared libraries cannot be JIT linked from an input buffer, pass the library's path as an argument instead\n";
+                success = false;
+                continue;
+            }
+
+            auto buffer = llvm::MemoryBuffer::getMemBufferCopy(bytes, name);
+            if (auto error = lld_jit_add_input(*jit, std::move(buffer), defined_symbols))
+            {
+                stderr_stream << "error: " << name << ": " << llvm::toString(std::move(error)) << "\n";
+                success = false;
+            }
+        }
+    }
+
+    if (success)
+    {
+        // Looking everything up in one go links all objects in a single session, resolving undefined symbols
+        // against archives, shared libraries and the host.
+        auto& session = jit->jit->getExecutionSession();
+        llvm::orc::SymbolLookupSet lookup_set;
+        for (auto& name : defined_symbols)
+        {
+            lookup_set.add(session.intern(name));
+        }
+
+        auto symbols = session.lookup(llvm::orc::makeJITDylibSearchOrder(&jit->jit->getMainJITDylib()), std::move(lookup_set));
+        if (!symbols)
+        {
+            stderr_stream << "error: " << llvm::toString(symbols.takeError()) << "\n";
+            success = false;
+        }
+        else
+        {
+            result.symbol_count = symbols->size();
+            result.symbol_pointer = (LLDJitSymbol*)allocate_fn(context, sizeof(LLDJitSymbol) * result.symbol_count, alignof(LLDJitSymbol));
+            u64 symbol_index = 0;
+            for (auto& [name, symbol] : *symbols)
+            {
+                result.symbol_pointer[symbol_index].name = lld_copy_string((*name).str(), allocate_fn, context);
+                result.symbol_pointer[symbol_index].address = symbol.getAddress().getValue();
+                symbol_index += 1;
+            }
+        }
+    }
+
+    jit->jit->getExecutionSession().setErrorReporter([](llvm::Error error)
+    {
+        llvm::consumeError(std::move(error));
+    });
+
+    if (success)
+    {
+        result.jit = jit.release();
+    }
+
+    result.success = success;
+    result.stderr_string = lld_copy_string(stderr_string, allocate_fn, context);
+    return result;
+}
+
+BB_EXPORT u64 lld_jit_lookup(LLDJit* jit, str name)
+{
+    auto symbol = jit->jit->lookupLinkerMangled(llvm::StringRef(name.pointer, name.length));
+    if (!symbol)
+    {
+        llvm::consumeError(symbol.takeError());
+        return 0;
+    }
+
+    return symbol->getValue();
+}
+
+BB_EXPORT void lld_jit_destroy(LLDJit* jit)
+{
+    delete jit;
+}
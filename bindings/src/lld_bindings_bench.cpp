@@ -0,0 +1,871 @@
+#include <lld_bindings.h>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/ObjectYAML/yaml2obj.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define fn static
+
+// Usage: lld_bindings_bench [--objects=N] [--functions=N] [--calls=N] [--archive-members=N] [--iterations=N]
+//                           [--flavors=elf,coff,wasm] [--mode=phases|session|threads|teardown] [--threads=N]
+//                           [--host-work-microseconds=N]
+// Synthesizes relocatable inputs for each flavor, links them repeatedly through the bindings and prints the results
+// as JSON on stdout. The modes measure:
+//     phases   per-link time, CPU time, peak memory and lld's phase timings of in-process links
+//     session  per-call latency of one-shot links against links through a session, with the given host work between
+//              calls standing in for the host's own code generation
+//     threads  throughput of links issued from 1, 2, 4, ... up to --threads host threads through as many worker
+//              processes, with the same number of links for every count. Workers are forked before any link, so
+//              this mode needs a fresh process.
+//     teardown per-link latency through one worker process with lld's regular teardown against arena teardown, where
+//              the worker forks a child per link that exits instead of destroying lld's context. Needs a fresh
+//              process as well.
+struct BenchConfig
+{
+    u64 object_count = 64;
+    u64 function_count = 256;
+    u64 call_count = 8;
+    u64 archive_member_count = 128;
+    u64 iteration_count = 5;
+    std::vector<std::string> flavors = { "elf", "coff", "wasm" };
+    std::string mode = "phases";
+    u64 thread_count = 8;
+    u64 host_work_microseconds = 0;
+};
+
+// Every function lives in its own section (except for Wasm, which has a single code section) and calls
+// `call_count` other functions spread over all objects and archive members, so the inputs are dominated by
+// sections, symbols and relocations.
+struct BenchFunction
+{
+    std::string name;
+    std::vector<std::string> callees;
+};
+
+struct BenchInputs
+{
+    std::vector<std::string> object_names;
+    std::vector<std::string> objects;
+    std::string archive;
+    u64 relocation_count = 0;
+    u64 input_bytes = 0;
+};
+
+fn std::string bench_function_name(u64 unit, u64 function)
+{
+    return "f_" + std::to_string(unit) + "_" + std::to_string(function);
+}
+
+// Units [0, object_count) are objects and the rest are archive members. Objects call into everything, archive
+// members only among themselves, so every member gets pulled in through some object.
+fn std::vector<BenchFunction> bench_unit_functions(const BenchConfig& config, u64 unit, u64& seed)
+{
+    u64 unit_count = config.object_count + config.archive_member_count;
+    bool member = unit >= config.object_count;
+    std::vector<BenchFunction> functions(config.function_count);
+
+    for (u64 i = 0; i < config.function_count; i += 1)
+    {
+        functions[i].name = bench_function_name(unit, i);
+        for (u64 call = 0; call < config.call_count; call += 1)
+        {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            u64 random = seed >> 33;
+            u64 callee_unit = member ? config.object_count + random % config.archive_member_count : random % unit_count;
+            functions[i].callees.push_back(bench_function_name(callee_unit, (random >> 12) % config.function_count));
+        }
+    }
+
+    return functions;
+}
+
+fn std::string bench_call_bytes(u64 call_count, llvm::StringRef call, llvm::StringRef end)
+{
+    std::string bytes;
+    for (u64 i = 0; i < call_count; i += 1)
+    {
+        bytes += call;
+    }
+
+    bytes += end;
+    return bytes;
+}
+
+fn std::string bench_elf_yaml(const std::vector<BenchFunction>& functions)
+{
+    std::string yaml;
+    llvm::raw_string_ostream stream(yaml);
+    stream << "--- !ELF\nFileHeader:\n  Class: ELFCLASS64\n  Data: ELFDATA2LSB\n  Type: ET_REL\n  Machine: EM_X86_64\nSections:\n";
+
+    llvm::StringMap<bool> defined;
+    for (auto& function : functions)
+    {
+        defined[function.name] = true;
+        stream << "  - Name: .text." << function.name << "\n    Type: SHT_PROGBITS\n    Flags: [ SHF_ALLOC, SHF_EXECINSTR ]\n    AddressAlign: 16\n";
+        stream << "    Content: " << bench_call_bytes(function.callees.size(), "e800000000", "c3") << "\n";
+        stream << "  - Name: .rela.text." << function.name << "\n    Type: SHT_RELA\n    Info: .text." << function.name << "\n    Relocations:\n";
+        for (u64 i = 0; i < function.callees.size(); i += 1)
+        {
+            stream << "      - Offset: " << 1 + i * 5 << "\n        Symbol: " << function.callees[i] << "\n        Type: R_X86_64_PLT32\n        Addend: -4\n";
+        }
+    }
+
+    stream << "Symbols:\n";
+    for (auto& function : functions)
+    {
+        stream << "  - Name: " << function.name << "\n    Type: STT_FUNC\n    Section: .text." << function.name << "\n    Binding: STB_GLOBAL\n";
+    }
+
+    for (auto& function : functions)
+    {
+        for (auto& callee : function.callees)
+        {
+            if (defined.insert({ callee, true }).second)
+            {
+                stream << "  - Name: " << callee << "\n    Binding: STB_GLOBAL\n";
+            }
+        }
+    }
+
+    return yaml;
+}
+
+fn std::string bench_coff_yaml(const std::vector<BenchFunction>& functions)
+{
+    std::string yaml;
+    llvm::raw_string_ostream stream(yaml);
+    stream << "--- !COFF\nheader:\n  Machine: IMAGE_FILE_MACHINE_AMD64\n  Characteristics: [ ]\nsections:\n";
+
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        auto& function = functions[i];
+        stream << "  - Name: '.text$" << i << "'\n    Characteristics: [ IMAGE_SCN_CNT_CODE, IMAGE_SCN_MEM_EXECUTE, IMAGE_SCN_MEM_READ ]\n    Alignment: 16\n";
+        stream << "    SectionData: " << bench_call_bytes(function.callees.size(), "E800000000", "C3") << "\n    Relocations:\n";
+        for (u64 call = 0; call < function.callees.size(); call += 1)
+        {
+            stream << "      - VirtualAddress: " << 1 + call * 5 << "\n        SymbolName: " << function.callees[call] << "\n        Type: IMAGE_REL_AMD64_REL32\n";
+        }
+    }
+
+    stream << "symbols:\n";
+    llvm::StringMap<bool> defined;
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        defined[functions[i].name] = true;
+        stream << "  - Name: " << functions[i].name << "\n    Value: 0\n    SectionNumber: " << i + 1 << "\n    SimpleType: IMAGE_SYM_TYPE_NULL\n    ComplexType: IMAGE_SYM_DTYPE_FUNCTION\n    StorageClass: IMAGE_SYM_CLASS_EXTERNAL\n";
+    }
+
+    for (auto& function : functions)
+    {
+        for (auto& callee : function.callees)
+        {
+            if (defined.insert({ callee, true }).second)
+            {
+                stream << "  - Name: " << callee << "\n    Value: 0\n    SectionNumber: 0\n    SimpleType: IMAGE_SYM_TYPE_NULL\n    ComplexType: IMAGE_SYM_DTYPE_FUNCTION\n    StorageClass: IMAGE_SYM_CLASS_EXTERNAL\n";
+            }
+        }
+    }
+
+    return yaml;
+}
+
+fn u64 bench_uleb128_size(u64 value)
+{
+    u64 size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size += 1;
+    }
+
+    return size;
+}
+
+// Calls use padded five-byte function indices, as relocatable Wasm code does, so they can be relocated in place.
+fn std::string bench_wasm_yaml(const std::vector<BenchFunction>& functions)
+{
+    llvm::StringMap<u64> symbol_indices;
+    std::vector<std::string> imports;
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        symbol_indices[functions[i].name] = i;
+    }
+
+    for (auto& function : functions)
+    {
+        for (auto& callee : function.callees)
+        {
+            if (symbol_indices.insert({ callee, functions.size() + imports.size() }).second)
+            {
+                imports.push_back(callee);
+            }
+        }
+    }
+
+    std::string yaml;
+    llvm::raw_string_ostream stream(yaml);
+    stream << "--- !WASM\nFileHeader:\n  Version: 0x1\nSections:\n";
+    stream << "  - Type: TYPE\n    Signatures:\n      - Index: 0\n        ParamTypes: [ ]\n        ReturnTypes: [ ]\n";
+
+    if (!imports.empty())
+    {
+        stream << "  - Type: IMPORT\n    Imports:\n";
+        for (auto& import : imports)
+        {
+            stream << "      - Module: env\n        Field: " << import << "\n        Kind: FUNCTION\n        SigIndex: 0\n";
+        }
+    }
+
+    stream << "  - Type: FUNCTION\n    FunctionTypes: [ ";
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        stream << (i ? ", 0" : "0");
+    }
+    stream << " ]\n";
+
+    // Relocation offsets are relative to the start of the code section payload.
+    stream << "  - Type: CODE\n    Relocations:\n";
+    u64 offset = bench_uleb128_size(functions.size());
+    for (auto& function : functions)
+    {
+        // One byte for the empty local declarations, then the calls and the end opcode.
+        u64 body_size = 1 + function.callees.size() * 6 + 1;
+        offset += bench_uleb128_size(body_size) + 1;
+        for (auto& callee : function.callees)
+        {
+            stream << "      - Type: R_WASM_FUNCTION_INDEX_LEB\n        Index: " << symbol_indices[callee] << "\n        Offset: " << offset + 1 << "\n";
+            offset += 6;
+        }
+
+        offset += 1;
+    }
+
+    stream << "    Functions:\n";
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        stream << "      - Index: " << imports.size() + i << "\n        Locals: [ ]\n        Body: " << bench_call_bytes(functions[i].callees.size(), "108080808000", "0B") << "\n";
+    }
+
+    stream << "  - Type: CUSTOM\n    Name: linking\n    Version: 2\n    SymbolTable:\n";
+    for (u64 i = 0; i < functions.size(); i += 1)
+    {
+        stream << "      - Index: " << i << "\n        Kind: FUNCTION\n        Name: " << functions[i].name << "\n        Flags: [ ]\n        Function: " << imports.size() + i << "\n";
+    }
+
+    for (u64 i = 0; i < imports.size(); i += 1)
+    {
+        stream << "      - Index: " << functions.size() + i << "\n        Kind: FUNCTION\n        Name: " << imports[i] << "\n        Flags: [ UNDEFINED ]\n        Function: " << i << "\n";
+    }
+
+    return yaml;
+}
+
+fn bool bench_yaml_to_object(const std::string& yaml, std::string& object)
+{
+    llvm::raw_string_ostream stream(object);
+    llvm::yaml::Input input(yaml);
+    return llvm::yaml::convertYAML(input, stream, [](const llvm::Twine& message)
+    {
+        llvm::errs() << "error: cannot synthesize input: " << message << "\n";
+    });
+}
+
+fn bool bench_synthesize(const BenchConfig& config, llvm::StringRef flavor, BenchInputs& inputs)
+{
+    u64 seed = 0x2545f4914f6cdd1dull;
+    std::vector<std::string> member_names;
+    std::vector<std::string> members;
+    u64 unit_count = config.object_count + config.archive_member_count;
+
+    for (u64 unit = 0; unit < unit_count; unit += 1)
+    {
+        auto functions = bench_unit_functions(config, unit, seed);
+        auto yaml = flavor == "elf" ? bench_elf_yaml(functions) : flavor == "coff" ? bench_coff_yaml(functions) : bench_wasm_yaml(functions);
+        std::string object;
+        if (!bench_yaml_to_object(yaml, object))
+        {
+            return false;
+        }
+
+        inputs.relocation_count += config.function_count * config.call_count;
+        inputs.input_bytes += object.size();
+
+        auto name = "unit" + std::to_string(unit) + (flavor == "coff" ? ".obj" : ".o");
+        if (unit < config.object_count)
+        {
+            inputs.object_names.push_back(std::move(name));
+            inputs.objects.push_back(std::move(object));
+        }
+        else
+        {
+            member_names.push_back(std::move(name));
+            members.push_back(std::move(object));
+        }
+    }
+
+    if (!members.empty())
+    {
+        std::vector<llvm::NewArchiveMember> archive_members;
+        for (u64 i = 0; i < members.size(); i += 1)
+        {
+            archive_members.emplace_back(llvm::MemoryBufferRef(members[i], member_names[i]));
+        }
+
+        auto archive_or_error = llvm::writeArchiveToBuffer(archive_members, llvm::SymtabWritingMode::NormalSymtab, llvm::object::Archive::K_GNU, /* Deterministic */ true, /* Thin */ false);
+        if (!archive_or_error)
+        {
+            llvm::errs() << "error: cannot synthesize archive: " << llvm::toString(archive_or_error.takeError()) << "\n";
+            return false;
+        }
+
+        inputs.archive = (*archive_or_error)->getBuffer().str();
+        inputs.input_bytes += inputs.archive.size();
+    }
+
+    return true;
+}
+
+fn u8* bench_allocate(void* context, u64 size, u64 alignment)
+{
+    auto* allocator = (llvm::BumpPtrAllocator*)context;
+    return (u8*)allocator->Allocate(size, llvm::Align(alignment));
+}
+
+// Inputs and arguments of one flavor's link. The arguments point into the storage, and the buffers into the inputs.
+struct BenchLink
+{
+    BenchInputs inputs;
+    std::string archive_name;
+    std::vector<LLDInputBuffer> buffers;
+    std::vector<std::string> arguments_storage;
+    std::vector<char*> arguments;
+};
+
+fn bool bench_prepare(const BenchConfig& config, llvm::StringRef flavor, BenchLink& link)
+{
+    auto& inputs = link.inputs;
+    if (!bench_synthesize(config, flavor, inputs))
+    {
+        return false;
+    }
+
+    for (u64 i = 0; i < inputs.objects.size(); i += 1)
+    {
+        link.buffers.push_back({ .name = { inputs.object_names[i].data(), inputs.object_names[i].size() }, .bytes = { (u8*)inputs.objects[i].data(), inputs.objects[i].size() } });
+    }
+
+    link.archive_name = flavor == "coff" ? "bench.lib" : "libbench.a";
+    if (!inputs.archive.empty())
+    {
+        link.buffers.push_back({ .name = { link.archive_name.data(), link.archive_name.size() }, .bytes = { (u8*)inputs.archive.data(), inputs.archive.size() } });
+    }
+
+    auto entry = bench_function_name(0, 0);
+    if (flavor == "elf")
+    {
+        link.arguments_storage = { "ld.lld", "-e", entry };
+    }
+    else if (flavor == "coff")
+    {
+        link.arguments_storage = { "lld-link", "/entry:" + entry, "/subsystem:console", "/nodefaultlib", "/opt:noref" };
+    }
+    else
+    {
+        link.arguments_storage = { "wasm-ld", "--entry=" + entry };
+    }
+
+    for (auto& argument : link.arguments_storage)
+    {
+        link.arguments.push_back(argument.data());
+    }
+
+    return true;
+}
+
+fn LLDFlavor bench_flavor(llvm::StringRef flavor)
+{
+    return flavor == "elf" ? LLD_FLAVOR_ELF : flavor == "coff" ? LLD_FLAVOR_COFF : LLD_FLAVOR_WASM;
+}
+
+fn LLDResult bench_link_one_shot(llvm::StringRef flavor, BenchLink& link, llvm::BumpPtrAllocator& allocator, const LLDLinkOptions& options)
+{
+    if (flavor == "elf")
+    {
+        return lld_elf_link_ex(link.arguments.data(), link.arguments.size(), false, false, bench_allocate, &allocator, &options);
+    }
+    else if (flavor == "coff")
+    {
+        return lld_coff_link_ex(link.arguments.data(), link.arguments.size(), false, false, bench_allocate, &allocator, &options);
+    }
+    else
+    {
+        return lld_wasm_link_ex(link.arguments.data(), link.arguments.size(), false, false, bench_allocate, &allocator, &options);
+    }
+}
+
+fn bool bench_check(llvm::StringRef flavor, const LLDResult& result)
+{
+    if (!result.success)
+    {
+        llvm::errs() << "error: " << flavor << " link failed\n" << llvm::StringRef(result.stderr_string.pointer, result.stderr_string.length);
+    }
+
+    return result.success;
+}
+
+fn u64 bench_now_nanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+fn bool bench_run_phases(const BenchConfig& config, llvm::StringRef flavor, llvm::json::OStream& json)
+{
+    BenchLink link;
+    if (!bench_prepare(config, flavor, link))
+    {
+        return false;
+    }
+
+    auto& inputs = link.inputs;
+    llvm::StringMap<u64> phase_nanoseconds;
+    std::vector<std::string> phase_order;
+    u64 wall_nanoseconds = 0;
+    u64 cpu_nanoseconds = 0;
+    u64 peak_resident_bytes = 0;
+    u64 output_bytes = 0;
+
+    for (u64 iteration = 0; iteration < config.iteration_count; iteration += 1)
+    {
+        llvm::BumpPtrAllocator allocator;
+        LLDLinkStats stats = {};
+        LLDLinkOptions options = {};
+        options.input_buffer_pointer = link.buffers.data();
+        options.input_buffer_count = link.buffers.size();
+        options.output_to_memory = true;
+        options.stats = &stats;
+
+        auto result = bench_link_one_shot(flavor, link, allocator, options);
+        if (!bench_check(flavor, result))
+        {
+            return false;
+        }
+
+        wall_nanoseconds += stats.wall_nanoseconds;
+        cpu_nanoseconds += stats.cpu_nanoseconds;
+        peak_resident_bytes = std::max(peak_resident_bytes, stats.peak_resident_bytes);
+        output_bytes = result.output.length;
+        for (auto& phase : llvm::ArrayRef(stats.phase_pointer, stats.phase_count))
+        {
+            auto name = llvm::StringRef(phase.name.pointer, phase.name.length);
+            auto [entry, inserted] = phase_nanoseconds.insert({ name, 0 });
+            if (inserted)
+            {
+                phase_order.push_back(name.str());
+            }
+
+            entry->second += phase.nanoseconds;
+        }
+    }
+
+    u64 iteration_count = std::max<u64>(config.iteration_count, 1);
+    json.object([&]()
+    {
+        json.attribute("flavor", flavor);
+        json.attribute("mode", "phases");
+        json.attribute("objects", (int64_t)config.object_count);
+        json.attribute("archive_members", (int64_t)config.archive_member_count);
+        json.attribute("functions", (int64_t)((config.object_count + config.archive_member_count) * config.function_count));
+        json.attribute("relocations", (int64_t)inputs.relocation_count);
+        json.attribute("input_bytes", (int64_t)inputs.input_bytes);
+        json.attribute("output_bytes", (int64_t)output_bytes);
+        json.attribute("iterations", (int64_t)config.iteration_count);
+        json.attribute("links_per_second", wall_nanoseconds ? config.iteration_count * 1e9 / wall_nanoseconds : 0.0);
+        json.attribute("wall_nanoseconds_mean", (int64_t)(wall_nanoseconds / iteration_count));
+        json.attribute("cpu_nanoseconds_mean", (int64_t)(cpu_nanoseconds / iteration_count));
+        json.attribute("peak_resident_bytes", (int64_t)peak_resident_bytes);
+        json.attributeObject("phase_nanoseconds_mean", [&]()
+        {
+            for (auto& name : phase_order)
+            {
+                json.attribute(name, (int64_t)(phase_nanoseconds[name] / iteration_count));
+            }
+        });
+    });
+
+    return true;
+}
+
+// Stands in for the host's own work between links, which a session overlaps with the previous link's teardown.
+fn void bench_host_work(const BenchConfig& config)
+{
+    if (config.host_work_microseconds)
+    {
+        u64 end = bench_now_nanoseconds() + config.host_work_microseconds * 1000;
+        while (bench_now_nanoseconds() < end)
+        {
+        }
+    }
+}
+
+struct BenchLatency
+{
+    u64 total_nanoseconds = 0;
+    u64 min_nanoseconds = UINT64_MAX;
+
+    void add(u64 nanoseconds)
+    {
+        total_nanoseconds += nanoseconds;
+        min_nanoseconds = std::min(min_nanoseconds, nanoseconds);
+    }
+};
+
+// The first link of each kind is a warm-up and not counted.
+fn bool bench_run_session(const BenchConfig& config, llvm::StringRef flavor, llvm::json::OStream& json)
+{
+    BenchLink link;
+    if (!bench_prepare(config, flavor, link))
+    {
+        return false;
+    }
+
+    LLDLinkOptions options = {};
+    options.input_buffer_pointer = link.buffers.data();
+    options.input_buffer_count = link.buffers.size();
+    options.output_to_memory = true;
+
+    BenchLatency one_shot;
+    for (u64 iteration = 0; iteration <= config.iteration_count; iteration += 1)
+    {
+        llvm::BumpPtrAllocator allocator;
+        bench_host_work(config);
+        u64 start = bench_now_nanoseconds();
+        auto result = bench_link_one_shot(flavor, link, allocator, options);
+        u64 end = bench_now_nanoseconds();
+        if (!bench_check(flavor, result))
+        {
+            return false;
+        }
+
+        if (iteration)
+        {
+            one_shot.add(end - start);
+        }
+    }
+
+    BenchLatency session_latency;
+    auto* session = lld_session_create(bench_flavor(flavor));
+    for (u64 iteration = 0; iteration <= config.iteration_count; iteration += 1)
+    {
+        llvm::BumpPtrAllocator allocator;
+        bench_host_work(config);
+        u64 start = bench_now_nanoseconds();
+        auto result = lld_session_link(session, link.arguments.data(), link.arguments.size(), false, bench_allocate, &allocator, &options);
+        u64 end = bench_now_nanoseconds();
+        if (!bench_check(flavor, result))
+        {
+            lld_session_destroy(session);
+            return false;
+        }
+
+        if (iteration)
+        {
+            session_latency.add(end - start);
+        }
+    }
+
+    lld_session_destroy(session);
+
+    u64 iteration_count = std::max<u64>(config.iteration_count, 1);
+    json.object([&]()
+    {
+        json.attribute("flavor", flavor);
+        json.attribute("mode", "session");
+        json.attribute("iterations", (int64_t)config.iteration_count);
+        json.attribute("host_work_microseconds", (int64_t)config.host_work_microseconds);
+        json.attribute("one_shot_nanoseconds_mean", (int64_t)(one_shot.total_nanoseconds / iteration_count));
+        json.attribute("one_shot_nanoseconds_min", (int64_t)(config.iteration_count ? one_shot.min_nanoseconds : 0));
+        json.attribute("session_nanoseconds_mean", (int64_t)(session_latency.total_nanoseconds / iteration_count));
+        json.attribute("session_nanoseconds_min", (int64_t)(config.iteration_count ? session_latency.min_nanoseconds : 0));
+    });
+
+    return true;
+}
+
+// Every count links the same `iterations * --threads` outputs from as many host threads as there are worker processes,
+// each link pinned to one lld thread so that the scaling comes from the worker processes alone.
+fn bool bench_run_threads(const BenchConfig& config, llvm::StringRef flavor, llvm::json::OStream& json)
+{
+    BenchLink link;
+    if (!bench_prepare(config, flavor, link))
+    {
+        return false;
+    }
+
+    LLDLinkOptions options = {};
+    options.input_buffer_pointer = link.buffers.data();
+    options.input_buffer_count = link.buffers.size();
+    options.output_to_memory = true;
+    options.thread_count = 1;
+
+    u64 link_count = std::max<u64>(config.iteration_count, 1) * config.thread_count;
+    struct Sample
+    {
+        u64 thread_count;
+        u64 wall_nanoseconds;
+    };
+    std::vector<Sample> samples;
+
+    for (u64 thread_count = 1; thread_count <= config.thread_count; thread_count *= 2)
+    {
+        if (!lld_set_worker_process_count((u32)thread_count))
+        {
+            llvm::errs() << "error: cannot start " << thread_count << " worker processes\n";
+            return false;
+        }
+
+        std::atomic<u64> next_link = 0;
+        std::atomic<bool> failed = false;
+        auto link_loop = [&]()
+        {
+            for (u64 i = next_link++; i < link_count && !failed; i = next_link++)
+            {
+                llvm::BumpPtrAllocator allocator;
+                if (!bench_check(flavor, bench_link_one_shot(flavor, link, allocator, options)))
+                {
+                    failed = true;
+                }
+            }
+        };
+
+        u64 start = bench_now_nanoseconds();
+        std::vector<std::thread> threads;
+        for (u64 i = 1; i < thread_count; i += 1)
+        {
+            threads.emplace_back(link_loop);
+        }
+
+        link_loop();
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        u64 end = bench_now_nanoseconds();
+
+        if (failed)
+        {
+            lld_set_worker_process_count(0);
+            return false;
+        }
+
+        samples.push_back({ thread_count, end - start });
+    }
+
+    lld_set_worker_process_count(0);
+
+    json.object([&]()
+    {
+        json.attribute("flavor", flavor);
+        json.attribute("mode", "threads");
+        json.attribute("links", (int64_t)link_count);
+        json.attribute("hardware_threads", (int64_t)std::thread::hardware_concurrency());
+        json.attributeArray("scaling", [&]()
+        {
+            for (auto& sample : samples)
+            {
+                json.object([&]()
+                {
+                    json.attribute("threads", (int64_t)sample.thread_count);
+                    json.attribute("wall_nanoseconds", (int64_t)sample.wall_nanoseconds);
+                    json.attribute("links_per_second", sample.wall_nanoseconds ? link_count * 1e9 / sample.wall_nanoseconds : 0.0);
+                    json.attribute("speedup", sample.wall_nanoseconds ? (double)samples[0].wall_nanoseconds / sample.wall_nanoseconds : 0.0);
+                });
+            }
+        });
+    });
+
+    return true;
+}
+
+// Both kinds link single-threaded, since a worker that has linked in process hands its arena children a parallel
+// executor without threads, and the first link of each kind is a warm-up and not counted.
+fn bool bench_run_teardown(const BenchConfig& config, llvm::StringRef flavor, llvm::json::OStream& json)
+{
+    BenchLink link;
+    if (!bench_prepare(config, flavor, link))
+    {
+        return false;
+    }
+
+    if (!lld_set_worker_process_count(1))
+    {
+        llvm::errs() << "error: cannot start a worker process\n";
+        return false;
+    }
+
+    LLDLinkOptions options = {};
+    options.input_buffer_pointer = link.buffers.data();
+    options.input_buffer_count = link.buffers.size();
+    options.output_to_memory = true;
+    options.thread_count = 1;
+
+    BenchLatency latencies[2];
+    for (u32 arena = 0; arena < 2; arena += 1)
+    {
+        options.arena_teardown = arena;
+        for (u64 iteration = 0; iteration <= config.iteration_count; iteration += 1)
+        {
+            llvm::BumpPtrAllocator allocator;
+            u64 start = bench_now_nanoseconds();
+            auto result = bench_link_one_shot(flavor, link, allocator, options);
+            u64 end = bench_now_nanoseconds();
+            if (!bench_check(flavor, result))
+            {
+                lld_set_worker_process_count(0);
+                return false;
+            }
+
+            if (iteration)
+            {
+                latencies[arena].add(end - start);
+            }
+        }
+    }
+
+    lld_set_worker_process_count(0);
+
+    u64 iteration_count = std::max<u64>(config.iteration_count, 1);
+    json.object([&]()
+    {
+        json.attribute("flavor", flavor);
+        json.attribute("mode", "teardown");
+        json.attribute("iterations", (int64_t)config.iteration_count);
+        json.attribute("destroy_nanoseconds_mean", (int64_t)(latencies[0].total_nanoseconds / iteration_count));
+        json.attribute("destroy_nanoseconds_min", (int64_t)(config.iteration_count ? latencies[0].min_nanoseconds : 0));
+        json.attribute("arena_nanoseconds_mean", (int64_t)(latencies[1].total_nanoseconds / iteration_count));
+        json.attribute("arena_nanoseconds_min", (int64_t)(config.iteration_count ? latencies[1].min_nanoseconds : 0));
+    });
+
+    return true;
+}
+
+fn bool bench_parse_arguments(int argc, char** argv, BenchConfig& config)
+{
+    for (int i = 1; i < argc; i += 1)
+    {
+        auto [name, value] = llvm::StringRef(argv[i]).split('=');
+        u64* number = name == "--objects" ? &config.object_count :
+            name == "--functions" ? &config.function_count :
+            name == "--calls" ? &config.call_count :
+            name == "--archive-members" ? &config.archive_member_count :
+            name == "--iterations" ? &config.iteration_count :
+            name == "--threads" ? &config.thread_count :
+            name == "--host-work-microseconds" ? &config.host_work_microseconds : nullptr;
+
+        if (number)
+        {
+            if (value.getAsInteger(10, *number))
+            {
+                llvm::errs() << "error: invalid value for " << name << ": " << value << "\n";
+                return false;
+            }
+        }
+        else if (name == "--flavors")
+        {
+            config.flavors.clear();
+            llvm::SmallVector<llvm::StringRef> flavors;
+            value.split(flavors, ',', -1, /* KeepEmpty */ false);
+            for (auto flavor : flavors)
+            {
+                if (flavor != "elf" && flavor != "coff" && flavor != "wasm")
+                {
+                    llvm::errs() << "error: unknown flavor " << flavor << "\n";
+                    return false;
+                }
+
+                config.flavors.push_back(flavor.str());
+            }
+        }
+        else if (name == "--mode")
+        {
+            if (value != "phases" && value != "session" && value != "threads" && value != "teardown")
+            {
+                llvm::errs() << "error: unknown mode " << value << "\n";
+                return false;
+            }
+
+            config.mode = value.str();
+        }
+        else
+        {
+            llvm::errs() << "error: unknown option " << argv[i] << "\n";
+            return false;
+        }
+    }
+
+    if (!config.object_count || !config.function_count)
+    {
+        llvm::errs() << "error: at least one object with one function is needed\n";
+        return false;
+    }
+
+    if (!config.thread_count)
+    {
+        llvm::errs() << "error: at least one thread is needed\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig config;
+    if (!bench_parse_arguments(argc, argv, config))
+    {
+        return 1;
+    }
+
+    bool success = true;
+    llvm::json::OStream json(llvm::outs(), /* IndentSize */ 2);
+    json.object([&]()
+    {
+        json.attribute("llvm_version", LLVM_VERSION_STRING);
+        json.attributeArray("benchmarks", [&]()
+        {
+            for (auto& flavor : config.flavors)
+            {
+                if (config.mode == "session")
+                {
+                    success &= bench_run_session(config, flavor, json);
+                }
+                else if (config.mode == "threads")
+                {
+                    success &= bench_run_threads(config, flavor, json);
+                }
+                else if (config.mode == "teardown")
+                {
+                    success &= bench_run_teardown(config, flavor, json);
+                }
+                else
+                {
+                    success &= bench_run_phases(config, flavor, json);
+                }
+            }
+        });
+    });
+
+    llvm::outs() << "\n";
+    return success ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <lld_bindings.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <vector>
+
+#define fn static
+
+fn u8* link_allocate(void* context, u64 size, u64 alignment)
+{
+    (void)context;
+    return (u8*)operator new(size, std::align_val_t(alignment));
+}
+
+// Usage: lld_bindings_link <coff|elf|mingw|macho|wasm> [linker argument...]
+// Runs one link through the bindings. Used to train the PGO build, so lld is not allowed to exit early: the profile
+// is only written when the process exits normally.
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <coff|elf|mingw|macho|wasm> [linker argument...]\n", argv[0]);
+        return 1;
+    }
+
+    const char* flavor = argv[1];
+    const char* program_name = nullptr;
+    if (strcmp(flavor, "coff") == 0)
+    {
+        program_name = "lld-link";
+    }
+    else if (strcmp(flavor, "elf") == 0 || strcmp(flavor, "mingw") == 0)
+    {
+        program_name = "ld.lld";
+    }
+    else if (strcmp(flavor, "macho") == 0)
+    {
+        program_name = "ld64.lld";
+    }
+    else if (strcmp(flavor, "wasm") == 0)
+    {
+        program_name = "wasm-ld";
+    }
+    else
+    {
+        fprintf(stderr, "error: unknown flavor %s\n", flavor);
+        return 1;
+    }
+
+    std::vector<char*> arguments;
+    arguments.push_back((char*)program_name);
+    for (int i = 2; i < argc; i += 1)
+    {
+        arguments.push_back(argv[i]);
+    }
+
+    LLDResult result = {};
+    if (strcmp(flavor, "coff") == 0)
+    {
+        result = lld_coff_link(arguments.data(), arguments.size(), false, false, link_allocate, nullptr);
+    }
+    else if (strcmp(flavor, "elf") == 0)
+    {
+        result = lld_elf_link(arguments.data(), arguments.size(), false, false, link_allocate, nullptr);
+    }
+    else if (strcmp(flavor, "mingw") == 0)
+    {
+        result = lld_mingw_link(arguments.data(), arguments.size(), false, false, link_allocate, nullptr);
+    }
+    else if (strcmp(flavor, "macho") == 0)
+    {
+        result = lld_macho_link(arguments.data(), arguments.size(), false, false, link_allocate, nullptr);
+    }
+    else
+    {
+        result = lld_wasm_link(arguments.data(), arguments.size(), false, false, link_allocate, nullptr);
+    }
+
+    fwrite(result.stdout_string.pointer, 1, result.stdout_string.length, stdout);
+    fwrite(result.stderr_string.pointer, 1, result.stderr_string.length, stderr);
+    return result.success ? 0 : 1;
+}
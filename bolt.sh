@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+
+set -eux
+
+# Sourced by build.sh when BIRTH_LLVM_BOLT=ON, after the shipped LLVM and bindings are built with --emit-relocs.
+# Instruments clang and the bindings training tools with llvm-bolt, runs pgo_training.sh through them and rewrites the
+# installed clang with the collected profile. liblld_bindings.a itself cannot be rewritten, since BOLT only works on
+# linked images, so its profile is installed as lib/lld_bindings.fdata for hosts that BOLT their own executable.
+
+LLVM_BOLT=${LLVM_BOLT:-llvm-bolt}
+MERGE_FDATA=${MERGE_FDATA:-merge-fdata}
+
+BOLT_DIR=$ROOT_DIR/build/$LLVM_BASENAME-bolt
+BOLT_BIN_DIR=$BOLT_DIR/bin
+BOLT_PROFILE_DIR=$BOLT_DIR/profiles
+rm -rf $BOLT_BIN_DIR $BOLT_PROFILE_DIR
+mkdir -p $BOLT_BIN_DIR $BOLT_PROFILE_DIR
+
+cmake --build $LLVM_BINDINGS_BUILD_DIR --target lld_bindings_link lld_bindings_bench
+
+# bolt_instrument <binary> <instrumented binary> <profile name>
+bolt_instrument() {
+    $LLVM_BOLT $1 -o $2 -instrument -instrumentation-file=$BOLT_PROFILE_DIR/$3.fdata -instrumentation-file-append-pid
+}
+
+bolt_instrument $LLVM_BINDINGS_BUILD_DIR/lld_bindings_link $BOLT_BIN_DIR/lld_bindings_link lld
+bolt_instrument $LLVM_BINDINGS_BUILD_DIR/lld_bindings_bench $BOLT_BIN_DIR/lld_bindings_bench lld
+
+# The instrumented clang has to sit next to the installed one to find its resource directory
+BOLT_CLANG=clang
+if [[ "$BIRTH_ENABLE_CLANG" == "true" ]]; then
+    BOLT_CLANG=$INSTALL_DIRECTORY_PATH/bin/clang-bolt-instrumented
+    bolt_instrument $INSTALL_DIRECTORY_PATH/bin/clang $BOLT_CLANG clang
+fi
+
+INSTALL_DIRECTORY_PATH=$INSTALL_DIRECTORY_PATH PGO_CLANG=$BOLT_CLANG PGO_BINDINGS_BUILD_DIR=$BOLT_BIN_DIR PGO_TRAINING_DIR=$BOLT_DIR/training EXE_EXTENSION=$EXE_EXTENSION ./pgo_training.sh
+
+# Both tools link the same archive, so their profiles describe the same functions and can be merged by name
+$MERGE_FDATA $BOLT_PROFILE_DIR/lld.fdata.* > $INSTALL_DIRECTORY_PATH/lib/lld_bindings.fdata
+
+if [[ "$BIRTH_ENABLE_CLANG" == "true" ]]; then
+    rm $BOLT_CLANG
+    $MERGE_FDATA $BOLT_PROFILE_DIR/clang.fdata.* > $BOLT_DIR/clang.fdata
+    $LLVM_BOLT $INSTALL_DIRECTORY_PATH/bin/clang -o $BOLT_DIR/clang -data=$BOLT_DIR/clang.fdata \
+        -reorder-blocks=ext-tsp \
+        -reorder-functions=hfsort \
+        -split-functions \
+        -split-all-cold \
+        -split-eh \
+        -icf=1 \
+        -use-gnu-stack \
+        -dyno-stats
+    cp $BOLT_DIR/clang $INSTALL_DIRECTORY_PATH/bin/clang
+fi
@@ -35,6 +35,34 @@ fi
 
 BIRTH_LLVM_ENABLE_ASSERTIONS_STRING="-DLLVM_ENABLE_ASSERTIONS=$BIRTH_LLVM_ENABLE_ASSERTIONS"
 
+# BIRTH_LLVM_PGO=ON builds an instrumented toolchain first, trains it with pgo_training.sh and builds the shipped one
+# with the resulting profile.
+BIRTH_LLVM_PGO=${BIRTH_LLVM_PGO:-OFF}
+BASENAME_PGO=""
+if [[ "$BIRTH_LLVM_PGO" == "ON" ]]; then
+    BASENAME_PGO="-pgo"
+fi
+
+# BIRTH_LLVM_BOLT=ON (Linux only) links the executables with --emit-relocs, profiles them with BOLT instrumentation
+# running pgo_training.sh and rewrites clang with the profile (bolt.sh). Needs llvm-bolt and merge-fdata on PATH.
+BIRTH_LLVM_BOLT=${BIRTH_LLVM_BOLT:-OFF}
+BASENAME_BOLT=""
+if [[ "$BIRTH_LLVM_BOLT" == "ON" ]]; then
+    if [[ "$BIRTH_OS" != "linux" ]]; then
+        echo "BOLT only supports ELF, BIRTH_LLVM_BOLT=ON needs BIRTH_OS=linux"
+        exit 1
+    fi
+    BASENAME_BOLT="-bolt"
+fi
+
+# BIRTH_LLVM_THINLTO=ON compiles LLVM and the bindings with -flto=thin, so the shipped static libraries hold ThinLTO
+# bitcode and the host link can inline across them. The host has to link with an lld at least as new as this LLVM.
+BIRTH_LLVM_THINLTO=${BIRTH_LLVM_THINLTO:-OFF}
+BASENAME_THINLTO=""
+if [[ "$BIRTH_LLVM_THINLTO" == "ON" ]]; then
+    BASENAME_THINLTO="-thinlto"
+fi
+
 ROOT_DIR=$(pwd)
 source basename.sh
 INSTALL_DIRECTORY_PATH=$ROOT_DIR/install/$LLVM_BASENAME
@@ -54,6 +82,11 @@ cmake $ROOT_DIR/zstd \
 cmake --build . --target install
 cd $ROOT_DIR
 
+case $BIRTH_OS in
+    windows) ZSTD_LIBRARY_PATH="$INSTALL_DIRECTORY_PATH/lib/zstd.lib";;
+    *) ZSTD_LIBRARY_PATH="$INSTALL_DIRECTORY_PATH/lib/libzstd.a";;
+esac
+
 ZLIB_BUILD_DIR=$ROOT_DIR/build/zlib-$LLVM_BASENAME
 mkdir -p $ZLIB_BUILD_DIR
 cd $ZLIB_BUILD_DIR
@@ -69,6 +102,11 @@ cmake $ROOT_DIR/zlib \
 cmake --build . --target install
 cd $ROOT_DIR
 
+case $BIRTH_OS in
+    windows) ZLIB_LIBRARY_PATH="$INSTALL_DIRECTORY_PATH/lib/z.lib";;
+    *) ZLIB_LIBRARY_PATH="$INSTALL_DIRECTORY_PATH/lib/libz.a";;
+esac
+
 case $BIRTH_OS in
     windows) BIRTH_OPTIONAL_TRIPLE_ARG="-DLLVM_HOST_TRIPLE=$BIRTH_ARCH-pc-windows-msvc";;
     *) BIRTH_OPTIONAL_TRIPLE_ARG="";;
@@ -88,9 +126,6 @@ else
     BIRTH_CMAKE_TARGETS="llvm-config llvm-tblgen"
 fi
 
-LLVM_BUILD_DIR=$ROOT_DIR/build/$LLVM_BASENAME
-mkdir -p $LLVM_BUILD_DIR
-
 LLVM_SOURCE_DIR="$ROOT_DIR/source/$LLVM_SOURCE_BASENAME"
 if [ ! -d "$LLVM_SOURCE_DIR" ]; then
     git clone --depth 1 --single-branch --branch llvmorg-$LLVM_VERSION https://github.com/llvm/llvm-project.git $LLVM_SOURCE_DIR
@@ -99,59 +134,128 @@ if [ ! -d "$LLVM_SOURCE_DIR" ]; then
     cd $ROOT_DIR
 fi
 
-cd $LLVM_BUILD_DIR
-cmake $LLVM_SOURCE_DIR/llvm \
-    -G Ninja \
-    -DCMAKE_INSTALL_PREFIX="$INSTALL_DIRECTORY_PATH" \
-    -DCMAKE_PREFIX_PATH="$INSTALL_DIRECTORY_PATH" \
-    -DCMAKE_BUILD_TYPE=$CMAKE_BUILD_TYPE \
-    -DCMAKE_C_COMPILER=clang \
-    -DCMAKE_CXX_COMPILER=clang++ \
-    -DCMAKE_ASM_COMPILER=clang \
-    -DCMAKE_LINKER_TYPE=LLD \
-    -DLLVM_ENABLE_PIC=OFF \
-    $BIRTH_OPTIONAL_TRIPLE_ARG \
-    $BIRTH_LLVM_ENABLE_PROJECTS_FLAG \
-    $BIRTH_LLVM_ENABLE_ASSERTIONS_STRING \
-    $BIRTH_WINDOWS_WORKAROUND \
-    -DBUILD_SHARED_LIBS=OFF \
-    -DLLVM_TARGETS_TO_BUILD="X86;AArch64" \
-    -DLLVM_PARALLEL_LINK_JOBS=1 \
-    -DLLVM_BUILD_LLVM_DYLIB=OFF \
-    -DLLVM_LINK_LLVM_DYLIB=OFF \
-    -DLLVM_OPTIMIZED_TABLEGEN=ON \
-    -DLLVM_ENABLE_BINDINGS=OFF \
-    -DLLVM_ENABLE_LIBEDIT=OFF \
-    -DLLVM_ENABLE_LIBPFM=OFF \
-    -DLLVM_ENABLE_LIBXML2=OFF \
-    -DLLVM_ENABLE_OCAMLDOC=OFF \
-    -DLLVM_ENABLE_PLUGINS=OFF \
-    -DLLVM_ENABLE_Z3_SOLVER=OFF \
-    -DLLVM_ENABLE_ZSTD=OFF \
-    -DLLVM_BUILD_UTILS=OFF \
-    -DLLVM_BUILD_TOOLS=OFF \
-    -DLLVM_BUILD_EXAMPLES=OFF \
-    -DLLVM_INCLUDE_TOOLS=ON \
-    -DLLVM_INCLUDE_UTILS=OFF \
-    -DLLVM_INCLUDE_TESTS=OFF \
-    -DLLVM_INCLUDE_EXAMPLES=OFF \
-    -DLLVM_INCLUDE_BENCHMARKS=OFF \
-    -DLLVM_INCLUDE_DOCS=OFF \
-    -DLLVM_TOOL_LLVM_LTO2_BUILD=OFF \
-    -DLLVM_TOOL_LLVM_LTO_BUILD=OFF \
-    -DLLVM_TOOL_LTO_BUILD=OFF \
-    -DLLVM_TOOL_REMARKS_SHLIB_BUILD=OFF \
-    -DLLD_BUILD_TOOLS=ON \
-    $BIRTH_CMAKE_CLANG_ARGS
-
-cmake --build . --target $BIRTH_CMAKE_TARGETS install
-cd $ROOT_DIR
+# build_llvm <build directory> <install prefix> [extra CMake arguments...]
+build_llvm() {
+    mkdir -p $1
+    cd $1
+    cmake $LLVM_SOURCE_DIR/llvm \
+        -G Ninja \
+        -DCMAKE_INSTALL_PREFIX="$2" \
+        -DCMAKE_PREFIX_PATH="$INSTALL_DIRECTORY_PATH" \
+        -DCMAKE_BUILD_TYPE=$CMAKE_BUILD_TYPE \
+        -DCMAKE_C_COMPILER=clang \
+        -DCMAKE_CXX_COMPILER=clang++ \
+        -DCMAKE_ASM_COMPILER=clang \
+        -DCMAKE_LINKER_TYPE=LLD \
+        -DLLVM_ENABLE_PIC=OFF \
+        $BIRTH_OPTIONAL_TRIPLE_ARG \
+        $BIRTH_LLVM_ENABLE_PROJECTS_FLAG \
+        $BIRTH_LLVM_ENABLE_ASSERTIONS_STRING \
+        $BIRTH_WINDOWS_WORKAROUND \
+        -DBUILD_SHARED_LIBS=OFF \
+        -DLLVM_TARGETS_TO_BUILD="X86;AArch64" \
+        -DLLVM_PARALLEL_LINK_JOBS=1 \
+        -DLLVM_BUILD_LLVM_DYLIB=OFF \
+        -DLLVM_LINK_LLVM_DYLIB=OFF \
+        -DLLVM_OPTIMIZED_TABLEGEN=ON \
+        -DLLVM_ENABLE_BINDINGS=OFF \
+        -DLLVM_ENABLE_LIBEDIT=OFF \
+        -DLLVM_ENABLE_LIBPFM=OFF \
+        -DLLVM_ENABLE_LIBXML2=OFF \
+        -DLLVM_ENABLE_OCAMLDOC=OFF \
+        -DLLVM_ENABLE_PLUGINS=OFF \
+        -DLLVM_ENABLE_Z3_SOLVER=OFF \
+        -DLLVM_ENABLE_ZSTD=FORCE_ON \
+        -DLLVM_USE_STATIC_ZSTD=ON \
+        -Dzstd_INCLUDE_DIR="$INSTALL_DIRECTORY_PATH/include" \
+        -Dzstd_LIBRARY="$ZSTD_LIBRARY_PATH" \
+        -Dzstd_STATIC_LIBRARY="$ZSTD_LIBRARY_PATH" \
+        -DLLVM_BUILD_UTILS=OFF \
+        -DLLVM_BUILD_TOOLS=OFF \
+        -DLLVM_BUILD_EXAMPLES=OFF \
+        -DLLVM_INCLUDE_TOOLS=ON \
+        -DLLVM_INCLUDE_UTILS=OFF \
+        -DLLVM_INCLUDE_TESTS=OFF \
+        -DLLVM_INCLUDE_EXAMPLES=OFF \
+        -DLLVM_INCLUDE_BENCHMARKS=OFF \
+        -DLLVM_INCLUDE_DOCS=OFF \
+        -DLLVM_TOOL_LLVM_LTO2_BUILD=OFF \
+        -DLLVM_TOOL_LLVM_LTO_BUILD=OFF \
+        -DLLVM_TOOL_LTO_BUILD=OFF \
+        -DLLVM_TOOL_REMARKS_SHLIB_BUILD=OFF \
+        -DLLD_BUILD_TOOLS=ON \
+        $BIRTH_CMAKE_CLANG_ARGS \
+        "${@:3}"
+
+    cmake --build . --target $BIRTH_CMAKE_TARGETS install
+    cd $ROOT_DIR
+}
+
+# build_bindings <build directory> <LLVM prefix> <C++ flags> [cmake --build arguments...]
+build_bindings() {
+    mkdir -p $1
+    cd $1
+    cmake $ROOT_DIR/bindings \
+        -G Ninja \
+        -DCMAKE_INSTALL_PREFIX="$2" \
+        -DCMAKE_PREFIX_PATH="$2" \
+        -DCMAKE_BUILD_TYPE=$CMAKE_BUILD_TYPE \
+        -DCMAKE_POSITION_INDEPENDENT_CODE=OFF \
+        -DCMAKE_C_COMPILER=clang \
+        -DCMAKE_CXX_COMPILER=clang++ \
+        -DCMAKE_ASM_COMPILER=clang \
+        -DCMAKE_LINKER_TYPE=LLD \
+        -DCMAKE_CXX_FLAGS="$3" \
+        -DCMAKE_EXE_LINKER_FLAGS="$EXE_LINKER_FLAGS" \
+        $ARCHIVER_ARGS \
+        -DLLVM_ZLIB="$ZLIB_LIBRARY_PATH" \
+        -DLLVM_ZSTD="$ZSTD_LIBRARY_PATH"
+
+    cmake --build . "${@:4}"
+    cd $ROOT_DIR
+}
 
 case "$BIRTH_OS" in
     windows) EXE_EXTENSION=".exe";;
     *) EXE_EXTENSION="";;
 esac
 
+# Shared by the LLVM and bindings executables
+EXE_LINKER_FLAGS=""
+
+# BOLT can only rewrite layout when the relocations survive the link
+if [[ "$BIRTH_LLVM_BOLT" == "ON" ]]; then
+    EXE_LINKER_FLAGS="$EXE_LINKER_FLAGS -Wl,--emit-relocs"
+fi
+
+BINDINGS_CXX_FLAGS=""
+LLVM_THINLTO_ARGS=""
+ARCHIVER_ARGS=""
+if [[ "$BIRTH_LLVM_THINLTO" == "ON" ]]; then
+    # Kept outside the build directories so that clean rebuilds still hit it
+    THINLTO_CACHE_DIR=$ROOT_DIR/build/thinlto-cache-$LLVM_BASENAME
+    mkdir -p $THINLTO_CACHE_DIR
+    case $BIRTH_OS in
+        windows) EXE_LINKER_FLAGS="$EXE_LINKER_FLAGS -Wl,/lldltocache:$(cygpath -m $THINLTO_CACHE_DIR)";;
+        macos) EXE_LINKER_FLAGS="$EXE_LINKER_FLAGS -Wl,-cache_path_lto,$THINLTO_CACHE_DIR";;
+        *) EXE_LINKER_FLAGS="$EXE_LINKER_FLAGS -Wl,--thinlto-cache-dir=$THINLTO_CACHE_DIR";;
+    esac
+    # The system archiver cannot index bitcode
+    ARCHIVER_ARGS="-DCMAKE_AR=$(command -v ${LLVM_AR:-llvm-ar}) -DCMAKE_RANLIB=$(command -v ${LLVM_RANLIB:-llvm-ranlib})"
+    LLVM_THINLTO_ARGS="-DLLVM_ENABLE_LTO=Thin $ARCHIVER_ARGS"
+    BINDINGS_CXX_FLAGS="-flto=thin"
+fi
+
+LLVM_PGO_ARGS=""
+if [[ "$BIRTH_LLVM_PGO" == "ON" ]]; then
+    source pgo.sh
+    LLVM_PGO_ARGS="-DLLVM_PROFDATA_FILE=$PGO_PROFDATA_FILE"
+    BINDINGS_CXX_FLAGS="$BINDINGS_CXX_FLAGS -fprofile-instr-use=$PGO_PROFDATA_FILE -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date"
+fi
+
+LLVM_BUILD_DIR=$ROOT_DIR/build/$LLVM_BASENAME
+build_llvm $LLVM_BUILD_DIR $INSTALL_DIRECTORY_PATH $LLVM_PGO_ARGS $LLVM_THINLTO_ARGS "-DCMAKE_EXE_LINKER_FLAGS=$EXE_LINKER_FLAGS"
+
 if [[ "$BIRTH_OS" == "macos" ]]; then
     PATH=$BIRTH_LLD_PREFIX:$PATH
 fi
@@ -170,23 +274,8 @@ fi
 rm $INSTALL_DIRECTORY_PATH/bin/amdgpu-arch$EXE_EXTENSION || true
 rm $INSTALL_DIRECTORY_PATH/bin/nvptx-arch$EXE_EXTENSION || true
 
-LLVM_BINDINGS_SOURCE_DIR=$ROOT_DIR/bindings
 LLVM_BINDINGS_BUILD_DIR=$ROOT_DIR/build/bindings-$LLVM_BASENAME
-mkdir -p $LLVM_BINDINGS_BUILD_DIR
-cd $LLVM_BINDINGS_BUILD_DIR
-
-cmake $LLVM_BINDINGS_SOURCE_DIR \
-    -G Ninja \
-    -DCMAKE_INSTALL_PREFIX="$INSTALL_DIRECTORY_PATH" \
-    -DCMAKE_PREFIX_PATH="$INSTALL_DIRECTORY_PATH" \
-    -DCMAKE_BUILD_TYPE=$CMAKE_BUILD_TYPE \
-    -DCMAKE_POSITION_INDEPENDENT_CODE=OFF \
-    -DCMAKE_C_COMPILER=clang \
-    -DCMAKE_CXX_COMPILER=clang++ \
-    -DCMAKE_ASM_COMPILER=clang \
-    -DCMAKE_LINKER_TYPE=LLD
-
-cmake --build .
+build_bindings $LLVM_BINDINGS_BUILD_DIR $INSTALL_DIRECTORY_PATH "$BINDINGS_CXX_FLAGS"
 
 if [[ "$BIRTH_OS" == "windows" ]]; then
     cp $LLVM_BINDINGS_BUILD_DIR/lld_bindings.lib $INSTALL_DIRECTORY_PATH/lib
@@ -195,6 +284,10 @@ else
 fi
 cp $ROOT_DIR/bindings/include/* $INSTALL_DIRECTORY_PATH/include
 
+if [[ "$BIRTH_LLVM_BOLT" == "ON" ]]; then
+    source bolt.sh
+fi
+
 cd $ROOT_DIR
 
 7z a -t7z -m0=lzma2 -mx=9 -mfb=64 -md=64m -ms=on $LLVM_BASENAME.7z $INSTALL_DIRECTORY_PATH
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+set -eux
+
+# Sourced by build.sh when BIRTH_LLVM_PGO=ON. Builds an instrumented LLVM and bindings next to the real ones, runs
+# pgo_training.sh through them and merges the raw profiles into PGO_PROFDATA_FILE, which build.sh then feeds to the
+# final LLVM and bindings builds. llvm-profdata has to come from the same LLVM release as the host clang.
+
+PGO_DIR=$ROOT_DIR/build/$LLVM_BASENAME-pgo
+PGO_PROFILE_DIR=$PGO_DIR/profiles
+PGO_PROFDATA_FILE=$PGO_DIR/lld.profdata
+PGO_INSTRUMENTED_INSTALL_DIR=$PGO_DIR/install
+PGO_BINDINGS_BUILD_DIR=$PGO_DIR/bindings
+
+build_llvm $PGO_DIR/llvm $PGO_INSTRUMENTED_INSTALL_DIR \
+    -DLLVM_BUILD_INSTRUMENTED=IR \
+    -DLLVM_BUILD_RUNTIME=OFF \
+    -DLLVM_PROFILE_DATA_DIR="$PGO_PROFILE_DIR"
+
+if [[ "$BIRTH_OS" == "macos" ]]; then
+    PATH=$BIRTH_LLD_PREFIX:$PATH build_bindings $PGO_BINDINGS_BUILD_DIR $PGO_INSTRUMENTED_INSTALL_DIR "-fprofile-generate=$PGO_PROFILE_DIR" --target lld_bindings_link lld_bindings_bench
+else
+    build_bindings $PGO_BINDINGS_BUILD_DIR $PGO_INSTRUMENTED_INSTALL_DIR "-fprofile-generate=$PGO_PROFILE_DIR" --target lld_bindings_link lld_bindings_bench
+fi
+
+# Only the training runs may leave profiles behind
+rm -rf $PGO_PROFILE_DIR
+mkdir -p $PGO_PROFILE_DIR
+
+# build_llvm only installs the LLVM libraries, the instrumented clang stays in its build directory
+PGO_CLANG=clang
+if [[ "$BIRTH_ENABLE_CLANG" == "true" ]]; then
+    PGO_CLANG=$PGO_DIR/llvm/bin/clang$EXE_EXTENSION
+fi
+
+INSTALL_DIRECTORY_PATH=$INSTALL_DIRECTORY_PATH PGO_CLANG=$PGO_CLANG PGO_BINDINGS_BUILD_DIR=$PGO_BINDINGS_BUILD_DIR PGO_TRAINING_DIR=$PGO_DIR/training EXE_EXTENSION=$EXE_EXTENSION ./pgo_training.sh
+
+${LLVM_PROFDATA:-llvm-profdata} merge -output=$PGO_PROFDATA_FILE $PGO_PROFILE_DIR/*.profraw
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+
+set -eux
+
+# Training workload for the PGO build, run by pgo.sh through the instrumented toolchain. It compiles the vendored zlib
+# and zstd sources at -O0 and -O2 (with the instrumented clang when the build has one), links them as shared
+# libraries with the options a typical host passes, then runs lld_bindings_bench for the synthesized inputs of every
+# flavor. Only the links matter; the outputs are thrown away.
+
+ROOT_DIR=$(pwd)
+# Better to stop than to train with a different clang than the caller asked for
+if ! command -v "$PGO_CLANG" > /dev/null; then
+    echo "PGO_CLANG=$PGO_CLANG is not an executable"
+    exit 1
+fi
+
+LINK="$PGO_BINDINGS_BUILD_DIR/lld_bindings_link$EXE_EXTENSION"
+BENCH="$PGO_BINDINGS_BUILD_DIR/lld_bindings_bench$EXE_EXTENSION"
+
+CORPUS_SOURCES="$(ls $ROOT_DIR/zlib/*.c $ROOT_DIR/zstd/lib/common/*.c $ROOT_DIR/zstd/lib/compress/*.c $ROOT_DIR/zstd/lib/decompress/*.c)"
+# zconf.h is generated, so zlib is compiled against the copy build.sh installed
+CORPUS_FLAGS="-g -DZSTD_DISABLE_ASM -I$INSTALL_DIRECTORY_PATH/include -I$ROOT_DIR/zstd/lib -I$ROOT_DIR/zstd/lib/common"
+if [[ "$BIRTH_OS" != "windows" ]]; then
+    CORPUS_FLAGS="$CORPUS_FLAGS -fPIC"
+fi
+
+case $BIRTH_ARCH in
+    aarch64) MACHO_ARCH=arm64;;
+    *) MACHO_ARCH=$BIRTH_ARCH;;
+esac
+
+rm -rf $PGO_TRAINING_DIR
+mkdir -p $PGO_TRAINING_DIR
+
+for OPTIMIZATION in -O0 -O2; do
+    OBJECT_DIR=$PGO_TRAINING_DIR/objects$OPTIMIZATION
+    mkdir -p $OBJECT_DIR
+    OBJECTS=""
+    for SOURCE in $CORPUS_SOURCES; do
+        OBJECT=$OBJECT_DIR/$(basename $(dirname $SOURCE))_$(basename $SOURCE .c).o
+        $PGO_CLANG $OPTIMIZATION $CORPUS_FLAGS -c $SOURCE -o $OBJECT
+        OBJECTS="$OBJECTS $OBJECT"
+    done
+
+    OUTPUT=$PGO_TRAINING_DIR/corpus$OPTIMIZATION
+    case $BIRTH_OS in
+        linux)
+            $LINK elf -shared -o $OUTPUT.so $OBJECTS
+            $LINK elf -shared --gc-sections --icf=all -O2 -o $OUTPUT-gc.so $OBJECTS
+            $LINK elf -shared --compress-debug-sections=zlib -o $OUTPUT-compressed.so $OBJECTS
+            $LINK elf -r -o $OUTPUT-relocatable.o $OBJECTS
+            ;;
+        macos)
+            $LINK macho -dylib -arch $MACHO_ARCH -platform_version macos 11.0 11.0 -undefined dynamic_lookup -o $OUTPUT.dylib $OBJECTS
+            $LINK macho -dylib -arch $MACHO_ARCH -platform_version macos 11.0 11.0 -undefined dynamic_lookup -dead_strip -o $OUTPUT-dead-strip.dylib $OBJECTS
+            ;;
+        windows)
+            $LINK coff /dll /noentry /force:unresolved /out:$OUTPUT.dll $OBJECTS
+            $LINK coff /dll /noentry /force:unresolved /debug /opt:ref /opt:icf /out:$OUTPUT-debug.dll $OBJECTS
+            ;;
+    esac
+done
+
+$BENCH --objects=32 --functions=64 --calls=8 --archive-members=16 --iterations=3 > $PGO_TRAINING_DIR/bench.json
@@ -5,7 +5,7 @@
 
 /* @(#) $Id$ */
 
-#include "zutil.h"
+#include "adler32_simd.h"
 
 #define BASE 65521U     /* largest prime smaller than 65536 */
 #define NMAX 5552
@@ -58,7 +58,8 @@
 #endif
 
 /* ========================================================================= */
-uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
+uLong ZLIB_INTERNAL zlib_adler32_scalar(uLong adler, const Bytef *buf,
+                                        z_size_t len) {
     unsigned long sum2;
     unsigned n;
 
@@ -124,6 +125,25 @@ uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
     return adler | (sum2 << 16);
 }
 
+/* ========================================================================= */
+uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
+#if defined(ZLIB_X86) || defined(ZLIB_ARM64)
+    if (buf != Z_NULL && len >= ADLER32_SIMD_MIN_LEN) {
+        unsigned features = zlib_cpu_features();
+#  if defined(ZLIB_X86)
+        if (features & CPU_FEATURE_AVX2)
+            return zlib_adler32_avx2(adler, buf, len);
+        if (features & CPU_FEATURE_SSSE3)
+            return zlib_adler32_ssse3(adler, buf, len);
+#  else
+        if (features & CPU_FEATURE_NEON)
+            return zlib_adler32_neon(adler, buf, len);
+#  endif
+    }
+#endif
+    return zlib_adler32_scalar(adler, buf, len);
+}
+
 /* ========================================================================= */
 uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len) {
     return adler32_z(adler, buf, len);
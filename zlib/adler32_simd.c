@@ -0,0 +1,202 @@
+/* adler32_simd.c -- SIMD kernels for the Adler-32 checksum
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * All kernels sum 32 byte blocks. For a block b[0..31] that follows the
+ * bytes already summed into s1 and s2,
+ *
+ *   s1' = s1 + (b[0] + ... + b[31])
+ *   s2' = s2 + 32 * s1 + (32 * b[0] + 31 * b[1] + ... + 1 * b[31])
+ *
+ * so a run of n blocks adds n * 32 * s1 to s2, 32 times the running byte sum
+ * before each block, and the weighted sum of each block. The vectors keep
+ * those three terms in 32-bit lanes and are reduced once per NMAX bytes,
+ * which keeps every lane from overflowing.
+ */
+
+#include "adler32_simd.h"
+
+#define BASE 65521U     /* largest prime smaller than 65536 */
+#define NMAX 5552
+/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
+
+#define BLOCK_SIZE 32
+
+/* sums the bytes left after the last full block */
+local uLong adler32_tail(unsigned long s1, unsigned long s2, const Bytef *buf,
+                         z_size_t len) {
+    while (len--) {
+        s1 += *buf++;
+        s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+    return s1 | (s2 << 16);
+}
+
+#if defined(ZLIB_X86)
+
+#include <immintrin.h>
+
+/* ========================================================================= */
+ZLIB_TARGET("ssse3")
+uLong ZLIB_INTERNAL zlib_adler32_ssse3(uLong adler, const Bytef *buf,
+                                       z_size_t len) {
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    z_size_t blocks = len / BLOCK_SIZE;
+    const __m128i taps1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                        24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i taps2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                        8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        __m128i v_ps, v_s1, v_s2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        v_s1 = zero;
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(
+                       _mm_maddubs_epi16(bytes1, taps1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(
+                       _mm_maddubs_epi16(bytes2, taps2), ones));
+            buf += BLOCK_SIZE;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (unsigned)_mm_cvtsi128_si32(v_s1)) % BASE;
+        s2 = (unsigned)_mm_cvtsi128_si32(v_s2) % BASE;
+    }
+    return adler32_tail(s1, s2, buf, len);
+}
+
+/* ========================================================================= */
+ZLIB_TARGET("avx2")
+uLong ZLIB_INTERNAL zlib_adler32_avx2(uLong adler, const Bytef *buf,
+                                      z_size_t len) {
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    z_size_t blocks = len / BLOCK_SIZE;
+    const __m256i taps = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                          24, 23, 22, 21, 20, 19, 18, 17,
+                                          16, 15, 14, 13, 12, 11, 10, 9,
+                                          8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        __m256i v_ps, v_s1, v_s2;
+        __m128i s1_sum, s2_sum;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)s2);
+        v_s1 = zero;
+        do {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i *)buf);
+
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(
+                       _mm256_maddubs_epi16(bytes, taps), ones));
+            buf += BLOCK_SIZE;
+        } while (--n);
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+        s1_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s1),
+                               _mm256_extracti128_si256(v_s1, 1));
+        s2_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s2),
+                               _mm256_extracti128_si256(v_s2, 1));
+        s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (unsigned)_mm_cvtsi128_si32(s1_sum)) % BASE;
+        s2 = (unsigned)_mm_cvtsi128_si32(s2_sum) % BASE;
+    }
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#elif defined(ZLIB_ARM64)
+
+#include <arm_neon.h>
+
+/* ========================================================================= */
+uLong ZLIB_INTERNAL zlib_adler32_neon(uLong adler, const Bytef *buf,
+                                      z_size_t len) {
+    static const unsigned short taps[BLOCK_SIZE] = {
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+    };
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    z_size_t blocks = len / BLOCK_SIZE;
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        uint32x4_t v_s1, v_s2;
+        /* per column byte sums, at most 173 * 255 so they fit 16 bits */
+        uint16x8_t column1, column2, column3, column4;
+        uint32x2_t s1s2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_s2 = vsetq_lane_u32((uint32_t)(s1 * n), vdupq_n_u32(0), 0);
+        v_s1 = vdupq_n_u32(0);
+        column1 = column2 = column3 = column4 = vdupq_n_u16(0);
+        do {
+            const uint8x16_t bytes1 = vld1q_u8(buf);
+            const uint8x16_t bytes2 = vld1q_u8(buf + 16);
+
+            /* running sum before this block, scaled by 32 after the loop */
+            v_s2 = vaddq_u32(v_s2, v_s1);
+            v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(bytes1), bytes2));
+            column1 = vaddw_u8(column1, vget_low_u8(bytes1));
+            column2 = vaddw_u8(column2, vget_high_u8(bytes1));
+            column3 = vaddw_u8(column3, vget_low_u8(bytes2));
+            column4 = vaddw_u8(column4, vget_high_u8(bytes2));
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = vshlq_n_u32(v_s2, 5);
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column1), vld1_u16(taps));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column1), vld1_u16(taps + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column2), vld1_u16(taps + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column2), vld1_u16(taps + 12));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column3), vld1_u16(taps + 16));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column3), vld1_u16(taps + 20));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column4), vld1_u16(taps + 24));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column4), vld1_u16(taps + 28));
+
+        s1s2 = vpadd_u32(vpadd_u32(vget_low_u32(v_s1), vget_high_u32(v_s1)),
+                         vpadd_u32(vget_low_u32(v_s2), vget_high_u32(v_s2)));
+        s1 = (s1 + vget_lane_u32(s1s2, 0)) % BASE;
+        s2 = (s2 + vget_lane_u32(s1s2, 1)) % BASE;
+    }
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#endif
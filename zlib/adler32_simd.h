@@ -0,0 +1,34 @@
+/* adler32_simd.h -- SIMD kernels for the Adler-32 checksum
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef ADLER32_SIMD_H
+#define ADLER32_SIMD_H
+
+#include "cpu_features.h"
+
+/* The portable implementation, used for short buffers and when the processor
+   has none of the extensions below. */
+uLong ZLIB_INTERNAL zlib_adler32_scalar(uLong adler, const Bytef *buf,
+                                        z_size_t len);
+
+/* The kernels take any length and a non-null buffer, but only pay off once
+   there are a few 32 byte blocks to sum. */
+#define ADLER32_SIMD_MIN_LEN 64
+
+#if defined(ZLIB_X86)
+uLong ZLIB_INTERNAL zlib_adler32_ssse3(uLong adler, const Bytef *buf,
+                                       z_size_t len);
+uLong ZLIB_INTERNAL zlib_adler32_avx2(uLong adler, const Bytef *buf,
+                                      z_size_t len);
+#elif defined(ZLIB_ARM64)
+uLong ZLIB_INTERNAL zlib_adler32_neon(uLong adler, const Bytef *buf,
+                                      z_size_t len);
+#endif
+
+#endif /* ADLER32_SIMD_H */
@@ -0,0 +1,146 @@
+/* cpu_features.c -- runtime detection of the SIMD extensions zlib can use
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "cpu_features.h"
+
+#if defined(ZLIB_X86) && defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(ZLIB_X86)
+#  include <cpuid.h>
+#elif defined(ZLIB_ARM64) && defined(_WIN32)
+#  include <windows.h>
+#elif defined(ZLIB_ARM64) && defined(__APPLE__)
+#  include <sys/sysctl.h>
+#elif defined(ZLIB_ARM64) && defined(__linux__)
+#  include <sys/auxv.h>
+#endif
+
+/* Set once the processor was queried, so that a processor without any of the
+   extensions is not queried again on every call. */
+#define CPU_FEATURES_DETECTED   (1U << 31)
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define LOAD(value) __atomic_load_n(&(value), __ATOMIC_RELAXED)
+#  define STORE(value, bits) __atomic_store_n(&(value), bits, __ATOMIC_RELAXED)
+#else
+#  define LOAD(value) (value)
+#  define STORE(value, bits) ((value) = (bits))
+#endif
+
+local volatile unsigned detected_features;
+
+#ifdef ZLIB_X86
+
+/* cpuid leaf 1 */
+#define ECX_PCLMULQDQ   (1U << 1)
+#define ECX_SSSE3       (1U << 9)
+#define ECX_OSXSAVE     (1U << 27)
+#define ECX_AVX         (1U << 28)
+#define EDX_SSE2        (1U << 26)
+/* cpuid leaf 7, subleaf 0 */
+#define EBX_AVX2        (1U << 5)
+#define ECX_VPCLMULQDQ  (1U << 10)
+/* xgetbv 0: the OS saves the SSE and AVX register state */
+#define XCR0_SSE_AVX    0x6U
+
+local void cpuid(unsigned leaf, unsigned subleaf, unsigned registers[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, (int)leaf, (int)subleaf);
+    registers[0] = (unsigned)values[0];
+    registers[1] = (unsigned)values[1];
+    registers[2] = (unsigned)values[2];
+    registers[3] = (unsigned)values[3];
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2],
+                  registers[3]);
+#endif
+}
+
+local unsigned xgetbv0(void) {
+#ifdef _MSC_VER
+    return (unsigned)_xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#endif
+}
+
+local unsigned detect_features(void) {
+    unsigned registers[4];
+    unsigned max_leaf;
+    unsigned features = 0;
+
+    cpuid(0, 0, registers);
+    max_leaf = registers[0];
+    if (max_leaf < 1)
+        return 0;
+
+    cpuid(1, 0, registers);
+    if (registers[3] & EDX_SSE2)
+        features |= CPU_FEATURE_SSE2;
+    if (registers[2] & ECX_SSSE3)
+        features |= CPU_FEATURE_SSSE3;
+    if (registers[2] & ECX_PCLMULQDQ)
+        features |= CPU_FEATURE_PCLMULQDQ;
+
+    /* AVX2 also needs the OS to save the upper halves of the registers */
+    if ((registers[2] & ECX_OSXSAVE) && (registers[2] & ECX_AVX) &&
+        (xgetbv0() & XCR0_SSE_AVX) == XCR0_SSE_AVX && max_leaf >= 7) {
+        cpuid(7, 0, registers);
+        if (registers[1] & EBX_AVX2)
+            features |= CPU_FEATURE_AVX2;
+        if (registers[2] & ECX_VPCLMULQDQ)
+            features |= CPU_FEATURE_VPCLMULQDQ;
+    }
+    return features;
+}
+
+#elif defined(ZLIB_ARM64)
+
+/* AT_HWCAP bit of the CRC32 instructions */
+#define HWCAP_CRC32_BIT (1UL << 7)
+
+local unsigned detect_features(void) {
+    /* Advanced SIMD is mandatory on AArch64 */
+    unsigned features = CPU_FEATURE_NEON;
+
+#if defined(__ARM_FEATURE_CRC32)
+    features |= CPU_FEATURE_ARM_CRC32;
+#elif defined(_WIN32)
+    if (IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE))
+        features |= CPU_FEATURE_ARM_CRC32;
+#elif defined(__APPLE__)
+    {
+        int value = 0;
+        size_t size = sizeof(value);
+        if (sysctlbyname("hw.optional.armv8_crc32", &value, &size,
+                         NULL, 0) == 0 && value)
+            features |= CPU_FEATURE_ARM_CRC32;
+    }
+#elif defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32_BIT)
+        features |= CPU_FEATURE_ARM_CRC32;
+#endif
+    return features;
+}
+
+#else
+
+local unsigned detect_features(void) {
+    return 0;
+}
+
+#endif
+
+/* ========================================================================= */
+unsigned ZLIB_INTERNAL zlib_cpu_features(void) {
+    unsigned features = LOAD(detected_features);
+    if (features == 0) {
+        features = detect_features() | CPU_FEATURES_DETECTED;
+        STORE(detected_features, features);
+    }
+    return features;
+}
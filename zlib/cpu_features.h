@@ -0,0 +1,44 @@
+/* cpu_features.h -- runtime detection of the SIMD extensions zlib can use
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include "zutil.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#  define ZLIB_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#  define ZLIB_ARM64
+#endif
+
+/* Kernels are compiled for their extension with a function attribute, so
+   they can live next to portable code and are only called after the
+   extension was detected. MSVC needs no attribute to use the intrinsics. */
+#if defined(__GNUC__) || defined(__clang__)
+#  define ZLIB_TARGET(extensions) __attribute__((target(extensions)))
+#else
+#  define ZLIB_TARGET(extensions)
+#endif
+
+#define CPU_FEATURE_SSE2        (1U << 0)
+#define CPU_FEATURE_SSSE3       (1U << 1)
+#define CPU_FEATURE_AVX2        (1U << 2)
+#define CPU_FEATURE_NEON        (1U << 3)
+#define CPU_FEATURE_PCLMULQDQ   (1U << 4)
+#define CPU_FEATURE_VPCLMULQDQ  (1U << 5)
+#define CPU_FEATURE_ARM_CRC32   (1U << 6)
+
+/* Returns the CPU_FEATURE_* bits of the running processor. The processor is
+   only queried on the first call; later calls return the cached bits, and
+   concurrent first calls are harmless since they all store the same value. */
+unsigned ZLIB_INTERNAL zlib_cpu_features(void);
+
+#endif /* CPU_FEATURES_H */
@@ -28,6 +28,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for Z_U4, Z_U8, z_crc_t, and FAR definitions */
+#include "crc32_simd.h"
 
  /*
   A CRC of a message is computed on N braids of words in the message, where
@@ -555,14 +556,21 @@ const z_crc_t FAR * ZEXPORT get_crc_table(void) {
 
 /* =========================================================================
  * Use ARM machine instructions if available. This will compute the CRC about
- * ten times faster than the braided calculation. This code does not check for
- * the presence of the CRC instruction at run time. __ARM_FEATURE_CRC32 will
- * only be defined if the compilation specifies an ARM processor architecture
- * that has the instructions. For example, compiling with -march=armv8.1-a or
- * -march=armv8-a+crc, or -march=native if the compile machine has the crc32
- * instructions.
+ * ten times faster than the braided calculation. Builds that specify an ARM
+ * processor architecture with the instructions define __ARM_FEATURE_CRC32 and
+ * use them without checking for them at run time (ARMCRC32). For example,
+ * compiling with -march=armv8.1-a or -march=armv8-a+crc, or -march=native if
+ * the compile machine has the crc32 instructions. Other AArch64 builds use them
+ * when they are found at run time, see crc32_z() below.
  */
-#ifdef ARMCRC32
+#if defined(ZLIB_ARM64) && W == 8
+#  define ARMCRC32_KERNEL
+
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#  else
+#    include <arm_acle.h>
+#  endif
 
 /*
    Constants empirically determined to maximize speed. These values are from
@@ -572,30 +580,19 @@ const z_crc_t FAR * ZEXPORT get_crc_table(void) {
 #define Z_BATCH_ZEROS 0xa10d3d0c    /* computed from Z_BATCH = 3990 */
 #define Z_BATCH_MIN 800             /* fewest words in a final batch */
 
-unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
-                              z_size_t len) {
-    z_crc_t val;
-    z_word_t crc1, crc2;
+/* Update the pre-conditioned crc with len bytes. */
+ZLIB_TARGET("+crc")
+local z_crc_t crc32_armv8(z_crc_t crc, const unsigned char FAR *buf,
+                          z_size_t len) {
+    z_crc_t crc1, crc2, val;
     const z_word_t *word;
-    z_word_t val0, val1, val2;
     z_size_t last, last2, i;
     z_size_t num;
 
-    /* Return initial CRC, if requested. */
-    if (buf == Z_NULL) return 0;
-
-#ifdef DYNAMIC_CRC_TABLE
-    once(&made, make_crc_table);
-#endif /* DYNAMIC_CRC_TABLE */
-
-    /* Pre-condition the CRC */
-    crc = (~crc) & 0xffffffff;
-
     /* Compute the CRC up to a word boundary. */
     while (len && ((z_size_t)buf & 7) != 0) {
         len--;
-        val = *buf++;
-        __asm__ volatile("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(val));
+        crc = __crc32b(crc, *buf++);
     }
 
     /* Prepare to compute the CRC on full 64-bit words word[0..num-1]. */
@@ -603,19 +600,14 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     num = len >> 3;
     len &= 7;
 
-    /* Do three interleaved CRCs to realize the throughput of one crc32x
-       instruction per cycle. Each CRC is calculated on Z_BATCH words. The
-       three CRCs are combined into a single CRC after each set of batches. */
+    /* Three CRCs over Z_BATCH words each, combined after every set. */
     while (num >= 3 * Z_BATCH) {
         crc1 = 0;
         crc2 = 0;
         for (i = 0; i < Z_BATCH; i++) {
-            val0 = word[i];
-            val1 = word[i + Z_BATCH];
-            val2 = word[i + 2 * Z_BATCH];
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc1) : "r"(val1));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc2) : "r"(val2));
+            crc = __crc32d(crc, word[i]);
+            crc1 = __crc32d(crc1, word[i + Z_BATCH]);
+            crc2 = __crc32d(crc2, word[i + 2 * Z_BATCH]);
         }
         word += 3 * Z_BATCH;
         num -= 3 * Z_BATCH;
@@ -623,20 +615,17 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
         crc = multmodp(Z_BATCH_ZEROS, crc) ^ crc2;
     }
 
-    /* Do one last smaller batch with the remaining words, if there are enough
-       to pay for the combination of CRCs. */
+    /* One last smaller batch, if there are enough words to pay for the
+       combination of CRCs. */
     last = num / 3;
     if (last >= Z_BATCH_MIN) {
         last2 = last << 1;
         crc1 = 0;
         crc2 = 0;
         for (i = 0; i < last; i++) {
-            val0 = word[i];
-            val1 = word[i + last];
-            val2 = word[i + last2];
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc1) : "r"(val1));
-            __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc2) : "r"(val2));
+            crc = __crc32d(crc, word[i]);
+            crc1 = __crc32d(crc1, word[i + last]);
+            crc2 = __crc32d(crc2, word[i + last2]);
         }
         word += 3 * last;
         num -= 3 * last;
@@ -645,23 +634,31 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
         crc = multmodp(val, crc) ^ crc2;
     }
 
-    /* Compute the CRC on any remaining words. */
-    for (i = 0; i < num; i++) {
-        val0 = word[i];
-        __asm__ volatile("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(val0));
-    }
-    word += num;
-
-    /* Complete the CRC on any remaining bytes. */
-    buf = (const unsigned char FAR *)word;
+    /* Compute the CRC on any remaining words and bytes. */
+    for (i = 0; i < num; i++)
+        crc = __crc32d(crc, word[i]);
+    buf = (const unsigned char FAR *)(word + num);
     while (len) {
         len--;
-        val = *buf++;
-        __asm__ volatile("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(val));
+        crc = __crc32b(crc, *buf++);
     }
+    return crc;
+}
+#endif
 
-    /* Return the CRC, post-conditioned. */
-    return crc ^ 0xffffffff;
+#ifdef ARMCRC32
+
+unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
+                              z_size_t len) {
+    /* Return initial CRC, if requested. */
+    if (buf == Z_NULL) return 0;
+
+#ifdef DYNAMIC_CRC_TABLE
+    once(&made, make_crc_table);
+#endif /* DYNAMIC_CRC_TABLE */
+
+    /* Pre-condition the CRC, compute it and post-condition it. */
+    return crc32_armv8((z_crc_t)((~crc) & 0xffffffff), buf, len) ^ 0xffffffff;
 }
 
 #else
@@ -691,8 +688,8 @@ local z_word_t crc_word_big(z_word_t data) {
 #endif
 
 /* ========================================================================= */
-unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
-                              z_size_t len) {
+local unsigned long crc32_braid(unsigned long crc,
+                                const unsigned char FAR *buf, z_size_t len) {
     /* Return initial CRC, if requested. */
     if (buf == Z_NULL) return 0;
 
@@ -1009,6 +1006,44 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     return crc ^ 0xffffffff;
 }
 
+/* =========================================================================
+ * Hand long buffers to the fastest kernel the processor has, found at run
+ * time, and leave the rest to the braided calculation.
+ */
+unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
+                              z_size_t len) {
+#if defined(ZLIB_X86) || defined(ARMCRC32_KERNEL)
+    if (buf != Z_NULL && len >= 64) {
+        unsigned features = zlib_cpu_features();
+        z_crc_t val = (z_crc_t)((~crc) & 0xffffffff);
+#  if defined(ZLIB_X86)
+        /* the folding kernels take multiples of 16 bytes */
+        z_size_t chunk = len & ~(z_size_t)15;
+        if ((features & CPU_FEATURE_VPCLMULQDQ) &&
+            (features & CPU_FEATURE_AVX2) && chunk >= CRC32_VPCLMUL_MIN_LEN)
+            val = zlib_crc32_vpclmul(val, buf, chunk);
+        else if (features & CPU_FEATURE_PCLMULQDQ)
+            val = zlib_crc32_pclmul(val, buf, chunk);
+        else
+            chunk = 0;
+#  else
+        z_size_t chunk = 0;
+        if (features & CPU_FEATURE_ARM_CRC32) {
+#    ifdef DYNAMIC_CRC_TABLE
+            once(&made, make_crc_table);
+#    endif /* DYNAMIC_CRC_TABLE */
+            val = crc32_armv8(val, buf, len);
+            chunk = len;
+        }
+#  endif
+        crc = val ^ 0xffffffff;
+        buf += chunk;
+        len -= chunk;
+    }
+#endif
+    return crc32_braid(crc, buf, len);
+}
+
 #endif
 
 /* ========================================================================= */
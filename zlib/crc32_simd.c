@@ -0,0 +1,160 @@
+/* crc32_simd.c -- carry-less multiplication kernels for the CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The kernels fold the message 128 bits at a time, as described in "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Gopal et
+ * al., Intel, 2009). Multiplying a 128-bit chunk by x^(D+32) and x^(D-32)
+ * modulo p(x), one constant per 64-bit half, moves it D bits further along
+ * the message, where it is xored into the data found there. What is left of
+ * the message is then reduced to 96, 64 and finally 32 bits with a Barrett
+ * reduction. All constants are bit-reflected and shifted left by one, to
+ * match the reflected CRC-32.
+ */
+
+#include "crc32_simd.h"
+
+#if defined(ZLIB_X86)
+
+#include <immintrin.h>
+
+/* x^(D-32) and x^(D+32) mod p(x) for the folding distances D, high half
+   first as _mm_set_epi64x takes them: the low half of a chunk is multiplied
+   by x^(D+32), the high half by x^(D-32) */
+#define K_FOLD_1024 0x14a7fe880, 0x1e88ef372
+#define K_FOLD_512  0x1c6e41596, 0x154442bd4
+#define K_FOLD_256  0x15a546366, 0x0f1da05aa
+#define K_FOLD_128  0x0ccaa009e, 0x1751997d0
+/* x^64 mod p(x), to fold 96 bits to 64 */
+#define K_FOLD_64   0x163cd6124
+/* floor(x^64 / p(x)) and p(x) for the Barrett reduction */
+#define K_BARRETT   0x1f7011641, 0x1db710641
+
+/* ========================================================================= */
+ZLIB_TARGET("sse2,pclmul")
+local __m128i fold128(__m128i x, __m128i k) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                         _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+/*
+  Fold the remaining 16 byte blocks into x and reduce it to the CRC.
+ */
+ZLIB_TARGET("sse2,pclmul")
+local z_crc_t crc32_fold_finish(__m128i x, const unsigned char FAR *buf,
+                                z_size_t len) {
+    const __m128i k128 = _mm_set_epi64x(K_FOLD_128);
+    const __m128i k64 = _mm_set_epi64x(0, K_FOLD_64);
+    const __m128i barrett = _mm_set_epi64x(K_BARRETT);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i t;
+
+    while (len >= 16) {
+        x = _mm_xor_si128(fold128(x, k128),
+                          _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 to 96 bits: the low half times x^96, added to the high half */
+    t = _mm_clmulepi64_si128(x, k128, 0x10);
+    x = _mm_xor_si128(_mm_srli_si128(x, 8), t);
+
+    /* 96 to 64 bits */
+    t = _mm_srli_si128(x, 4);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, low32), k64, 0x00);
+    x = _mm_xor_si128(x, t);
+
+    /* Barrett reduction to 32 bits */
+    t = _mm_clmulepi64_si128(_mm_and_si128(x, low32), barrett, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), barrett, 0x00);
+    x = _mm_xor_si128(x, t);
+    return (z_crc_t)(unsigned)_mm_cvtsi128_si32(_mm_srli_si128(x, 4));
+}
+
+/* ========================================================================= */
+ZLIB_TARGET("sse2,pclmul")
+z_crc_t ZLIB_INTERNAL zlib_crc32_pclmul(z_crc_t crc,
+                                        const unsigned char FAR *buf,
+                                        z_size_t len) {
+    const __m128i k512 = _mm_set_epi64x(K_FOLD_512);
+    const __m128i k128 = _mm_set_epi64x(K_FOLD_128);
+    __m128i x1, x2, x3, x4;
+
+    x1 = _mm_loadu_si128((const __m128i *)buf);
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 32));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    buf += 64;
+    len -= 64;
+
+    /* four independent folds of 512 bits keep the multiplier busy */
+    while (len >= 64) {
+        x1 = _mm_xor_si128(fold128(x1, k512),
+                           _mm_loadu_si128((const __m128i *)buf));
+        x2 = _mm_xor_si128(fold128(x2, k512),
+                           _mm_loadu_si128((const __m128i *)(buf + 16)));
+        x3 = _mm_xor_si128(fold128(x3, k512),
+                           _mm_loadu_si128((const __m128i *)(buf + 32)));
+        x4 = _mm_xor_si128(fold128(x4, k512),
+                           _mm_loadu_si128((const __m128i *)(buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+
+    x2 = _mm_xor_si128(fold128(x1, k128), x2);
+    x3 = _mm_xor_si128(fold128(x2, k128), x3);
+    x4 = _mm_xor_si128(fold128(x3, k128), x4);
+    return crc32_fold_finish(x4, buf, len);
+}
+
+/* ========================================================================= */
+ZLIB_TARGET("avx2,pclmul,vpclmulqdq")
+local __m256i fold256(__m256i y, __m256i k) {
+    return _mm256_xor_si256(_mm256_clmulepi64_epi128(y, k, 0x00),
+                            _mm256_clmulepi64_epi128(y, k, 0x11));
+}
+
+/* ========================================================================= */
+ZLIB_TARGET("avx2,pclmul,vpclmulqdq")
+z_crc_t ZLIB_INTERNAL zlib_crc32_vpclmul(z_crc_t crc,
+                                         const unsigned char FAR *buf,
+                                         z_size_t len) {
+    const __m256i k1024 = _mm256_set_epi64x(K_FOLD_1024, K_FOLD_1024);
+    const __m256i k256 = _mm256_set_epi64x(K_FOLD_256, K_FOLD_256);
+    const __m128i k128 = _mm_set_epi64x(K_FOLD_128);
+    __m256i y1, y2, y3, y4;
+    __m128i x;
+
+    y1 = _mm256_loadu_si256((const __m256i *)buf);
+    y2 = _mm256_loadu_si256((const __m256i *)(buf + 32));
+    y3 = _mm256_loadu_si256((const __m256i *)(buf + 64));
+    y4 = _mm256_loadu_si256((const __m256i *)(buf + 96));
+    y1 = _mm256_xor_si256(y1, _mm256_setr_epi32((int)crc, 0, 0, 0,
+                                                0, 0, 0, 0));
+    buf += 128;
+    len -= 128;
+
+    /* the same folds as zlib_crc32_pclmul, two 128-bit lanes per register */
+    while (len >= 128) {
+        y1 = _mm256_xor_si256(fold256(y1, k1024),
+                              _mm256_loadu_si256((const __m256i *)buf));
+        y2 = _mm256_xor_si256(fold256(y2, k1024),
+                              _mm256_loadu_si256((const __m256i *)(buf + 32)));
+        y3 = _mm256_xor_si256(fold256(y3, k1024),
+                              _mm256_loadu_si256((const __m256i *)(buf + 64)));
+        y4 = _mm256_xor_si256(fold256(y4, k1024),
+                              _mm256_loadu_si256((const __m256i *)(buf + 96)));
+        buf += 128;
+        len -= 128;
+    }
+
+    y2 = _mm256_xor_si256(fold256(y1, k256), y2);
+    y3 = _mm256_xor_si256(fold256(y2, k256), y3);
+    y4 = _mm256_xor_si256(fold256(y3, k256), y4);
+    x = _mm_xor_si128(fold128(_mm256_castsi256_si128(y4), k128),
+                      _mm256_extracti128_si256(y4, 1));
+    return crc32_fold_finish(x, buf, len);
+}
+
+#endif
@@ -0,0 +1,33 @@
+/* crc32_simd.h -- carry-less multiplication kernels for the CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "cpu_features.h"
+
+#if defined(ZLIB_X86)
+
+/* Smallest lengths the folding kernels accept. Both only take multiples of
+   16 bytes; the caller finishes the remainder. */
+#define CRC32_PCLMUL_MIN_LEN 64
+#define CRC32_VPCLMUL_MIN_LEN 256
+
+/* Update the pre-conditioned (inverted) crc with len bytes and return the
+   new, still inverted, value. */
+z_crc_t ZLIB_INTERNAL zlib_crc32_pclmul(z_crc_t crc,
+                                        const unsigned char FAR *buf,
+                                        z_size_t len);
+z_crc_t ZLIB_INTERNAL zlib_crc32_vpclmul(z_crc_t crc,
+                                         const unsigned char FAR *buf,
+                                         z_size_t len);
+
+#endif
+
+#endif /* CRC32_SIMD_H */
@@ -50,6 +50,7 @@
 /* @(#) $Id$ */
 
 #include "deflate.h"
+#include "slide_hash_simd.h"
 
 const char deflate_copyright[] =
    " deflate 1.3.1 Copyright 1995-2024 Jean-loup Gailly and Mark Adler ";
@@ -184,27 +185,41 @@ local const config configuration_table[10] = {
      __attribute__((no_sanitize("memory")))
 #  endif
 #endif
-local void slide_hash(deflate_state *s) {
-    unsigned n, m;
+local void slide_table(Posf *table, unsigned n, uInt wsize) {
+    unsigned m;
     Posf *p;
-    uInt wsize = s->w_size;
 
-    n = s->hash_size;
-    p = &s->head[n];
+#if defined(ZLIB_X86)
+    unsigned features = zlib_cpu_features();
+    if (features & CPU_FEATURE_AVX2) {
+        zlib_slide_hash_avx2(table, n, wsize);
+        return;
+    }
+    if (features & CPU_FEATURE_SSE2) {
+        zlib_slide_hash_sse2(table, n, wsize);
+        return;
+    }
+#elif defined(ZLIB_ARM64)
+    if (zlib_cpu_features() & CPU_FEATURE_NEON) {
+        zlib_slide_hash_neon(table, n, wsize);
+        return;
+    }
+#endif
+
+    p = &table[n];
     do {
         m = *--p;
         *p = (Pos)(m >= wsize ? m - wsize : NIL);
     } while (--n);
-    n = wsize;
+}
+
+local void slide_hash(deflate_state *s) {
+    slide_table(s->head, s->hash_size, s->w_size);
 #ifndef FASTEST
-    p = &s->prev[n];
-    do {
-        m = *--p;
-        *p = (Pos)(m >= wsize ? m - wsize : NIL);
-        /* If n is not on any hash chain, prev[n] is garbage but
-         * its value will never be used.
-         */
-    } while (--n);
+    /* prev[n] is garbage for any n that is not on a hash chain, but its
+     * value will never be used.
+     */
+    slide_table(s->prev, s->w_size, s->w_size);
 #endif
 }
 
@@ -1336,6 +1351,50 @@ int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
 }
 
 #ifndef FASTEST
+/* Compare eight bytes at a time in longest_match() on 64-bit little-endian
+ * targets, where unaligned loads are cheap and the first differing byte of a
+ * word is given by the count of trailing zero bits of the xor of the words.
+ * Define NO_WORD_MATCH to use the byte or UNALIGNED_OK code instead.
+ */
+#if !defined(NO_WORD_MATCH) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__aarch64__)) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define WORD_MATCH
+typedef unsigned long long match_word;
+#  define ctz64(word) ((unsigned)__builtin_ctzll(word))
+#elif !defined(NO_WORD_MATCH) && defined(_MSC_VER) && \
+    (defined(_M_X64) || defined(_M_ARM64))
+#  include <intrin.h>
+#  define WORD_MATCH
+typedef unsigned __int64 match_word;
+local unsigned ctz64(match_word word) {
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (unsigned)index;
+}
+#endif
+
+#ifdef WORD_MATCH
+/* Unaligned loads; the compilers above turn these into single moves. */
+local ush load_16(const Bytef *p) {
+    ush value;
+    zmemcpy((Bytef *)&value, p, sizeof(value));
+    return value;
+}
+
+local unsigned load_32(const Bytef *p) {
+    unsigned value;
+    zmemcpy((Bytef *)&value, p, sizeof(value));
+    return value;
+}
+
+local match_word load_64(const Bytef *p) {
+    match_word value;
+    zmemcpy((Bytef *)&value, p, sizeof(value));
+    return value;
+}
+#endif
+
 /* ===========================================================================
  * Set match_start to the longest match starting at the given string and
  * return its length. Matches shorter or equal to prev_length are discarded,
@@ -1360,7 +1419,16 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
     Posf *prev = s->prev;
     uInt wmask = s->w_mask;
 
-#ifdef UNALIGNED_OK
+#if defined(WORD_MATCH)
+    /* A candidate must match the two bytes ending the best match so far and
+     * its start. Once best_len >= 3 a longer match also needs the first four
+     * bytes, otherwise only the first two are checked.
+     */
+    register ush scan_end = load_16(scan + best_len - 1);
+    register unsigned scan_start = load_32(scan);
+    register unsigned start_mask = best_len >= MIN_MATCH ? 0xffffffffU :
+                                                         0xffffU;
+#elif defined(UNALIGNED_OK)
     /* Compare two bytes at a time. Note: this is not always beneficial.
      * Try with and without -DUNALIGNED_OK to check.
      */
@@ -1402,7 +1470,30 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
          * However the length of the match is limited to the lookahead, so
          * the output of deflate is not affected by the uninitialized values.
          */
-#if (defined(UNALIGNED_OK) && MAX_MATCH == 258)
+#if defined(WORD_MATCH)
+        if (load_16(match + best_len - 1) != scan_end ||
+            ((load_32(match) ^ scan_start) & start_mask) != 0) continue;
+
+        /* scan[2] and match[2] are equal as explained below, so compare
+         * the 256 bytes at strstart + 2 up to strstart + 257 a word at a
+         * time and stop at the lowest differing byte of the first word
+         * that differs.
+         */
+        Assert(scan[2] == match[2], "scan[2]?");
+        len = 2;
+        do {
+            match_word diff = load_64(scan + len) ^ load_64(match + len);
+            if (diff != 0) {
+                len += (int)(ctz64(diff) >> 3);
+                break;
+            }
+            len += (int)sizeof(match_word);
+        } while (len < MAX_MATCH);
+
+        Assert(scan + len <= s->window + (unsigned)(s->window_size - 1),
+               "wild scan");
+
+#elif (defined(UNALIGNED_OK) && MAX_MATCH == 258)
         /* This code assumes sizeof(unsigned short) == 2. Do not use
          * UNALIGNED_OK if your compiler uses a different size.
          */
@@ -1468,13 +1559,16 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
         len = MAX_MATCH - (int)(strend - scan);
         scan = strend - MAX_MATCH;
 
-#endif /* UNALIGNED_OK */
+#endif /* WORD_MATCH */
 
         if (len > best_len) {
             s->match_start = cur_match;
             best_len = len;
             if (len >= nice_match) break;
-#ifdef UNALIGNED_OK
+#if defined(WORD_MATCH)
+            scan_end = load_16(scan + best_len - 1);
+            start_mask = 0xffffffffU;
+#elif defined(UNALIGNED_OK)
             scan_end = *(ushf*)(scan + best_len - 1);
 #else
             scan_end1  = scan[best_len - 1];
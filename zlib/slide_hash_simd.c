@@ -0,0 +1,53 @@
+/* slide_hash_simd.c -- SIMD kernels to slide the deflate hash chains
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Since NIL is 0, m >= wsize ? m - wsize : NIL is an unsigned saturating
+ * subtraction, which all of these extensions have for 16-bit lanes.
+ */
+
+#include "slide_hash_simd.h"
+
+#if defined(ZLIB_X86)
+
+#include <immintrin.h>
+
+/* ========================================================================= */
+ZLIB_TARGET("sse2")
+void ZLIB_INTERNAL zlib_slide_hash_sse2(ushf *table, unsigned entries,
+                                        unsigned wsize) {
+    const __m128i w = _mm_set1_epi16((short)wsize);
+    __m128i *p = (__m128i *)table;
+
+    for (; entries; entries -= 16, p += 2) {
+        _mm_storeu_si128(p, _mm_subs_epu16(_mm_loadu_si128(p), w));
+        _mm_storeu_si128(p + 1, _mm_subs_epu16(_mm_loadu_si128(p + 1), w));
+    }
+}
+
+/* ========================================================================= */
+ZLIB_TARGET("avx2")
+void ZLIB_INTERNAL zlib_slide_hash_avx2(ushf *table, unsigned entries,
+                                        unsigned wsize) {
+    const __m256i w = _mm256_set1_epi16((short)wsize);
+    __m256i *p = (__m256i *)table;
+
+    for (; entries; entries -= 16, p++)
+        _mm256_storeu_si256(p, _mm256_subs_epu16(_mm256_loadu_si256(p), w));
+}
+
+#elif defined(ZLIB_ARM64)
+
+#include <arm_neon.h>
+
+/* ========================================================================= */
+void ZLIB_INTERNAL zlib_slide_hash_neon(ushf *table, unsigned entries,
+                                        unsigned wsize) {
+    const uint16x8_t w = vdupq_n_u16((uint16_t)wsize);
+
+    for (; entries; entries -= 16, table += 16) {
+        vst1q_u16(table, vqsubq_u16(vld1q_u16(table), w));
+        vst1q_u16(table + 8, vqsubq_u16(vld1q_u16(table + 8), w));
+    }
+}
+
+#endif
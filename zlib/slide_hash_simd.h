@@ -0,0 +1,28 @@
+/* slide_hash_simd.h -- SIMD kernels to slide the deflate hash chains
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef SLIDE_HASH_SIMD_H
+#define SLIDE_HASH_SIMD_H
+
+#include "cpu_features.h"
+
+/* Replace every entry m of table[0..entries-1] with m - wsize, or with 0 (NIL)
+   if m < wsize. entries has to be a multiple of 16, which hash_size and
+   w_size always are since both are at least 256. */
+#if defined(ZLIB_X86)
+void ZLIB_INTERNAL zlib_slide_hash_sse2(ushf *table, unsigned entries,
+                                        unsigned wsize);
+void ZLIB_INTERNAL zlib_slide_hash_avx2(ushf *table, unsigned entries,
+                                        unsigned wsize);
+#elif defined(ZLIB_ARM64)
+void ZLIB_INTERNAL zlib_slide_hash_neon(ushf *table, unsigned entries,
+                                        unsigned wsize);
+#endif
+
+#endif /* SLIDE_HASH_SIMD_H */
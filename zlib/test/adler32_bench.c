@@ -0,0 +1,97 @@
+/* adler32_bench.c -- compare the Adler-32 kernels across buffer sizes
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Every kernel the processor supports is checked against the portable
+ * implementation and timed on buffers from 16 bytes to 1 MiB, each over
+ * about the same number of bytes in total.
+ */
+
+#include "adler32_simd.h"
+
+#include <stdio.h>
+#include <time.h>
+
+typedef uLong (*adler32_kernel)(uLong adler, const Bytef *buf, z_size_t len);
+
+typedef struct {
+    const char *name;
+    adler32_kernel kernel;
+    unsigned feature;
+} kernel_entry;
+
+local const kernel_entry kernels[] = {
+    { "scalar", zlib_adler32_scalar, 0 },
+#if defined(ZLIB_X86)
+    { "ssse3", zlib_adler32_ssse3, CPU_FEATURE_SSSE3 },
+    { "avx2", zlib_adler32_avx2, CPU_FEATURE_AVX2 },
+#elif defined(ZLIB_ARM64)
+    { "neon", zlib_adler32_neon, CPU_FEATURE_NEON },
+#endif
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+#define MAX_SIZE (1UL << 20)
+#define BYTES_PER_RUN (256UL << 20)
+
+local double seconds(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+    static const z_size_t sizes[] = { 16, 64, 256, 1024, 4096, 65536, MAX_SIZE };
+    unsigned features = zlib_cpu_features();
+    unsigned long state = 1;
+    unsigned char *buffer = malloc(MAX_SIZE);
+    size_t s, k;
+    z_size_t i;
+    int failed = 0;
+
+    if (buffer == NULL)
+        return 1;
+    for (i = 0; i < MAX_SIZE; i++) {
+        state = state * 1103515245UL + 12345UL;
+        buffer[i] = (unsigned char)(state >> 16);
+    }
+
+    printf("%10s", "size");
+    for (k = 0; k < KERNEL_COUNT; k++)
+        printf(" %12s", kernels[k].name);
+    printf("   (MB/s)\n");
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        z_size_t size = sizes[s];
+        unsigned long iterations = BYTES_PER_RUN / size;
+        uLong expected = zlib_adler32_scalar(1, buffer, size);
+
+        printf("%10lu", (unsigned long)size);
+        for (k = 0; k < KERNEL_COUNT; k++) {
+            uLong adler = 1;
+            unsigned long n;
+            double start, elapsed;
+
+            if ((features & kernels[k].feature) != kernels[k].feature) {
+                printf(" %12s", "-");
+                continue;
+            }
+            if (kernels[k].kernel(1, buffer, size) != expected) {
+                printf(" %12s", "MISMATCH");
+                failed = 1;
+                continue;
+            }
+
+            /* chain the checksums so the calls cannot be dropped */
+            start = seconds();
+            for (n = 0; n < iterations; n++)
+                adler = kernels[k].kernel(adler, buffer, size);
+            elapsed = seconds() - start;
+            if (adler == 0)
+                printf("!");
+            printf(" %12.0f", elapsed > 0 ?
+                   (double)iterations * size / elapsed / 1e6 : 0.0);
+        }
+        printf("\n");
+    }
+
+    free(buffer);
+    return failed;
+}
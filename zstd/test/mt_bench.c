@@ -0,0 +1,121 @@
+/*
+ * mt_bench.c -- time ZSTD_compress2 across worker counts
+ *
+ * Compresses the same synthetic buffer with ZSTD_c_nbWorkers set to 0, 1, 2,
+ * 4, ... up to the given maximum, checks that every frame decompresses back to
+ * the input and prints the wall time, the speedup over the single-threaded
+ * compressor and the decompression speed. Decompression is single-threaded, so
+ * the last column only shows that the Huffman decoder (the assembly loop on
+ * x86-64) is linked in and stays level across worker counts. Fails when the library rejects worker counts, which it does when
+ * it was built without ZSTD_MULTITHREAD.
+ *
+ * Usage: mt_bench [size in MiB (default 256)] [max workers (default 8)] [level (default 3)]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zstd.h"
+
+static double wallSeconds(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Words drawn from a small vocabulary with runs of random bytes in between,
+ * so the input compresses like text but is not trivially repetitive. */
+static void fillInput(unsigned char* buffer, size_t size)
+{
+    static const char* const words[] = {
+        "frame ", "block ", "literal ", "match ", "offset ", "window ", "worker ",
+        "level ", "dictionary ", "sequence ", "entropy ", "huffman ", "\n"
+    };
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    size_t position = 0;
+
+    while (position < size) {
+        size_t length;
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        if ((state >> 60) == 0) {
+            length = (size_t)(state >> 32) % 64;
+            if (length > size - position) length = size - position;
+            {   size_t i;
+                for (i = 0; i < length; i++) {
+                    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                    buffer[position + i] = (unsigned char)(state >> 56);
+            }   }
+        } else {
+            const char* word = words[(state >> 33) % (sizeof(words) / sizeof(words[0]))];
+            length = strlen(word);
+            if (length > size - position) length = size - position;
+            memcpy(buffer + position, word, length);
+        }
+        position += length;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t const size = (size_t)(argc > 1 ? atoi(argv[1]) : 256) << 20;
+    int const maxWorkers = argc > 2 ? atoi(argv[2]) : 8;
+    int const level = argc > 3 ? atoi(argv[3]) : 3;
+    size_t const bound = ZSTD_compressBound(size);
+    unsigned char* const input = (unsigned char*)malloc(size);
+    unsigned char* const compressed = (unsigned char*)malloc(bound);
+    unsigned char* const decompressed = (unsigned char*)malloc(size);
+    ZSTD_CCtx* const cctx = ZSTD_createCCtx();
+    double baseline = 0;
+    int workers;
+
+    if (!size || !input || !compressed || !decompressed || !cctx) {
+        fprintf(stderr, "error: cannot allocate %u MiB buffers\n", (unsigned)(size >> 20));
+        return 1;
+    }
+    fillInput(input, size);
+    /* Fault the output pages in up front so the first decompression is not charged for them. */
+    memset(decompressed, 0, size);
+
+    printf("%u MiB at level %d\n", (unsigned)(size >> 20), level);
+    printf("%8s %10s %10s %8s %10s\n", "workers", "seconds", "MB/s", "speedup", "dec MB/s");
+    for (workers = 0; workers <= maxWorkers; workers = workers ? workers * 2 : 1) {
+        size_t compressedSize, decompressedSize;
+        double start, elapsed, decompressElapsed;
+
+        ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+        if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, workers))) {
+            fprintf(stderr, "error: %d workers rejected, libzstd was built without ZSTD_MULTITHREAD\n", workers);
+            return 1;
+        }
+
+        start = wallSeconds();
+        compressedSize = ZSTD_compress2(cctx, compressed, bound, input, size);
+        elapsed = wallSeconds() - start;
+        if (ZSTD_isError(compressedSize)) {
+            fprintf(stderr, "error: %s\n", ZSTD_getErrorName(compressedSize));
+            return 1;
+        }
+
+        start = wallSeconds();
+        decompressedSize = ZSTD_decompress(decompressed, size, compressed, compressedSize);
+        decompressElapsed = wallSeconds() - start;
+        if (decompressedSize != size || memcmp(input, decompressed, size) != 0) {
+            fprintf(stderr, "error: round trip with %d workers does not match the input\n", workers);
+            return 1;
+        }
+
+        if (!workers) baseline = elapsed;
+        printf("%8d %10.3f %10.1f %7.2fx %10.1f\n", workers, elapsed, (double)size / elapsed / 1e6,
+               elapsed > 0 ? baseline / elapsed : 0.0, (double)size / decompressElapsed / 1e6);
+    }
+
+    ZSTD_freeCCtx(cctx);
+    free(decompressed);
+    free(compressed);
+    free(input);
+    return 0;
+}